@@ -0,0 +1,96 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "AlbumCache.h"
+
+#include <algorithm>
+
+CAlbumCache::CAlbumCache(CGLDeletionQueue& deletionQueue, size_t budget)
+  : m_deletionQueue(deletionQueue),
+    m_budget(budget)
+{
+}
+
+GLuint CAlbumCache::Find(const std::string& file)
+{
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if (it->file == file)
+    {
+      m_entries.splice(m_entries.begin(), m_entries, it);
+      m_hits++;
+      return it->texture;
+    }
+  }
+  return 0;
+}
+
+void CAlbumCache::Add(const std::string& file, GLuint texture, size_t bytes, size_t plain)
+{
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if (it->file == file)
+    {
+      m_bytes -= it->bytes;
+      m_saved -= it->plain - it->bytes;
+      m_deletionQueue.DeleteTexture(it->texture);
+      m_entries.erase(it);
+      break;
+    }
+  }
+
+  m_entries.push_front({file, texture, bytes, std::max(plain, bytes)});
+  m_bytes += bytes;
+  m_saved += m_entries.front().plain - bytes;
+  Evict();
+}
+
+void CAlbumCache::SetBudget(size_t budget)
+{
+  m_budget = budget;
+  Evict();
+}
+
+void CAlbumCache::Evict()
+{
+  // The newest cover stays, even when it alone is over the budget
+  while (m_bytes > m_budget && m_entries.size() > 1)
+  {
+    const Entry& oldest = m_entries.back();
+    m_bytes -= oldest.bytes;
+    m_saved -= oldest.plain - oldest.bytes;
+    m_deletionQueue.DeleteTexture(oldest.texture);
+    m_entries.pop_back();
+  }
+}
+
+void CAlbumCache::Clear()
+{
+  for (const auto& entry : m_entries)
+    m_deletionQueue.DeleteTexture(entry.texture);
+  Forget();
+}
+
+void CAlbumCache::Forget()
+{
+  m_entries.clear();
+  m_bytes = 0;
+  m_saved = 0;
+}
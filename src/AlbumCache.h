@@ -0,0 +1,74 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "GLDeletionQueue.h"
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <list>
+#include <string>
+
+// Keeps the GPU textures of the last album covers, so going back and forth
+// between songs or presets skips the decode and the upload. The least
+// recently used covers are deleted once the textures exceed the budget.
+class CAlbumCache
+{
+public:
+  CAlbumCache(CGLDeletionQueue& deletionQueue, size_t budget);
+
+  // Texture of the file, 0 if not cached. The cache keeps owning it.
+  GLuint Find(const std::string& file);
+
+  // Takes ownership of the texture. bytes is its GPU memory, plain the
+  // memory it would take as RGBA.
+  void Add(const std::string& file, GLuint texture, size_t bytes, size_t plain);
+
+  // Evicts right away if the cache is over the new budget
+  void SetBudget(size_t budget);
+
+  void Clear();
+  // Drops the textures without deleting, for a lost context
+  void Forget();
+
+  size_t Bytes() const { return m_bytes; }
+  size_t SavedBytes() const { return m_saved; }
+  size_t Count() const { return m_entries.size(); }
+  unsigned int Hits() const { return m_hits; }
+
+private:
+  void Evict();
+
+  struct Entry
+  {
+    std::string file;
+    GLuint texture;
+    size_t bytes;
+    size_t plain;
+  };
+
+  CGLDeletionQueue& m_deletionQueue;
+  size_t m_budget;
+  std::list<Entry> m_entries; // most recently used first
+  size_t m_bytes = 0;
+  size_t m_saved = 0;
+  unsigned int m_hits = 0;
+};
@@ -0,0 +1,177 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "AlbumLoader.h"
+
+#include <kodi/Filesystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Downscale factor of the preview, the dot grid hides the lower resolution
+#define ALBUM_PREVIEW_FACTOR (8)
+// Mip level of a compressed texture with the same downscale
+#define ALBUM_PREVIEW_LEVEL (3)
+// Smallest width of a preview, smaller images are shown directly
+#define ALBUM_PREVIEW_MIN_SIZE (32)
+// Size of the disk cache, the oldest covers are removed beyond it
+#define ALBUM_DISK_CACHE_BUDGET (64 * 1024 * 1024)
+
+CAlbumLoader::CAlbumLoader(CThreadPool& pool, const std::string& cacheFolder)
+  : m_pool(pool),
+    m_cacheFolder(cacheFolder)
+{
+}
+
+CAlbumLoader::~CAlbumLoader()
+{
+  m_tasks.Wait();
+}
+
+void CAlbumLoader::Load(const std::string& file, GLenum format, bool needPixels, size_t maxPixels)
+{
+  unsigned int generation;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    generation = ++m_generation;
+    m_ready = false;
+  }
+
+  m_tasks.Run(m_pool, [this, file, format, needPixels, maxPixels, generation]
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    Result result;
+    result.file = file;
+
+    std::string cacheFile = format ? CacheFile(file, format, maxPixels) : "";
+    if (!cacheFile.empty())
+      result.cached = CTextureCompressor::Load(cacheFile, result.texture) && result.texture.format == format;
+    if (!result.cached)
+      result.texture = CTextureData();
+
+    if (!result.cached || needPixels)
+    {
+      result.image.Load(file);
+      while (maxPixels && static_cast<size_t>(result.image.Width()) * result.image.Height() > maxPixels &&
+             result.image.Width() > 1 && result.image.Height() > 1)
+        result.image = result.image.Downscale(2);
+    }
+
+    if (format && !result.cached && CTextureCompressor::Compress(result.image, format, result.texture) && !cacheFile.empty() &&
+        CTextureCompressor::Save(cacheFile, result.texture))
+      PruneCache();
+
+    // A compressed preview is a mip level of the texture
+    if (!result.texture.Empty())
+    {
+      if (result.texture.levels[0].width / ALBUM_PREVIEW_FACTOR >= ALBUM_PREVIEW_MIN_SIZE)
+        result.previewLevel = ALBUM_PREVIEW_LEVEL;
+    }
+    else if (result.image.Width() / ALBUM_PREVIEW_FACTOR >= ALBUM_PREVIEW_MIN_SIZE)
+    {
+      result.preview = result.image.Downscale(ALBUM_PREVIEW_FACTOR);
+    }
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (generation != m_generation)
+      return;
+    m_result = std::move(result);
+    m_ready = true;
+  });
+}
+
+void CAlbumLoader::Cancel()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_generation;
+  m_ready = false;
+}
+
+bool CAlbumLoader::Poll(Result& result)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_ready)
+    return false;
+
+  result = std::move(m_result);
+  m_result = Result();
+  m_ready = false;
+  return true;
+}
+
+std::string CAlbumLoader::CacheFile(const std::string& file, GLenum format, size_t maxPixels) const
+{
+  // Thumbnails are replaced under the same name, so the size and the
+  // modification time are part of the key as well
+  kodi::vfs::FileStatus status;
+  if (m_cacheFolder.empty() || !kodi::vfs::StatFile(file, status))
+    return "";
+
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : file)
+  {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+
+  char name[96];
+  snprintf(name, sizeof(name), "%016llx_%llx_%llx_%zx.%x", static_cast<unsigned long long>(hash),
+           static_cast<unsigned long long>(status.GetSize()), static_cast<unsigned long long>(status.GetModificationTime()),
+           maxPixels, format);
+  return m_cacheFolder + name;
+}
+
+void CAlbumLoader::PruneCache() const
+{
+  // Oldest first by the time the cover was cached. The covers of a changed
+  // thumbnail are never asked for again and go this way too.
+  std::vector<kodi::vfs::CDirEntry> entries;
+  if (!kodi::vfs::GetDirectory(m_cacheFolder, "", entries))
+    return;
+
+  std::vector<std::pair<time_t, kodi::vfs::CDirEntry*>> files;
+  size_t bytes = 0;
+  for (auto& entry : entries)
+  {
+    if (entry.IsFolder())
+      continue;
+    files.emplace_back(entry.DateTime(), &entry);
+    bytes += static_cast<size_t>(entry.Size());
+  }
+  if (bytes <= ALBUM_DISK_CACHE_BUDGET)
+    return;
+
+  std::sort(files.begin(), files.end(), [](const std::pair<time_t, kodi::vfs::CDirEntry*>& a,
+                                           const std::pair<time_t, kodi::vfs::CDirEntry*>& b)
+  {
+    return a.first < b.first;
+  });
+  for (const auto& file : files)
+  {
+    if (bytes <= ALBUM_DISK_CACHE_BUDGET)
+      break;
+    if (kodi::vfs::DeleteFile(file.second->Path()))
+      bytes -= static_cast<size_t>(file.second->Size());
+  }
+}
@@ -0,0 +1,78 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "Image.h"
+#include "TextureCompressor.h"
+#include "ThreadPool.h"
+
+#include <mutex>
+#include <string>
+
+// Decodes album covers on the thread pool. Besides the full image a small
+// preview is made, which can be shown right away while the full image is
+// still being uploaded.
+//
+// With a compressed format the cover is also compressed, and kept in a disk
+// cache in the add-on's user folder, so a cover seen before needs neither
+// the decode nor the compression. The disk cache is kept under a size
+// limit, the covers cached longest ago are removed first.
+class CAlbumLoader
+{
+public:
+  struct Result
+  {
+    std::string file;
+    CImage preview; // empty for small images
+    CImage image; // empty for a cached texture unless the pixels are needed
+    CTextureData texture; // compressed image with mip levels
+    int previewLevel = -1; // level of the texture to show as preview
+    bool cached = false; // texture came from the disk cache
+    double ms = 0.0; // decode and compression or cache load time
+  };
+
+  CAlbumLoader(CThreadPool& pool, const std::string& cacheFolder);
+  ~CAlbumLoader();
+
+  // Starts loading, the result of a still running Load() is dropped. A
+  // format of 0 leaves the image uncompressed. Images over maxPixels are
+  // halved until they fit, 0 for no limit.
+  void Load(const std::string& file, GLenum format, bool needPixels, size_t maxPixels = 0);
+  // Drops the result of a running Load()
+  void Cancel();
+
+  // True once per finished Load()
+  bool Poll(Result& result);
+
+private:
+  std::string CacheFile(const std::string& file, GLenum format, size_t maxPixels) const;
+  // Removes the oldest covers while the cache is over its budget
+  void PruneCache() const;
+
+  CThreadPool& m_pool;
+  CTaskGroup m_tasks;
+  const std::string m_cacheFolder;
+
+  std::mutex m_mutex;
+  unsigned int m_generation = 0;
+  bool m_ready = false;
+  Result m_result;
+};
@@ -0,0 +1,99 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "AnalysisGovernor.h"
+
+// Weight of a new measurement in the moving average
+#define GOVERNOR_SMOOTHING (0.1)
+// Number of consecutive callbacks needed before the tier is changed
+#define GOVERNOR_STEP_DOWN (8)
+#define GOVERNOR_STEP_UP (256)
+// Only step up again if the better tier is expected to fit with some headroom
+#define GOVERNOR_HEADROOM (0.5)
+
+CAnalysisGovernor::CAnalysisGovernor(const std::vector<AnalysisTier>& tiers)
+  : m_tiers(tiers),
+    m_activeTier(0)
+{
+}
+
+void CAnalysisGovernor::SetBudget(unsigned int budgetUs)
+{
+  m_budgetUs = budgetUs;
+  m_activeTier = 0;
+  m_callback = 0;
+  m_averageUs = 0.0;
+  m_overBudget = 0;
+  m_underBudget = 0;
+}
+
+bool CAnalysisGovernor::NextCallback()
+{
+  unsigned int hop = m_tiers[m_activeTier].hop;
+  return (m_callback++ % hop) == 0;
+}
+
+bool CAnalysisGovernor::Measure(double elapsedUs)
+{
+  m_averageUs = m_averageUs ? m_averageUs + (elapsedUs - m_averageUs) * GOVERNOR_SMOOTHING : elapsedUs;
+
+  if (!m_budgetUs)
+    return false;
+
+  // Cost of a tier is spread over its hop, so compare the amortized time
+  const AnalysisTier& tier = m_tiers[m_activeTier];
+  double amortizedUs = m_averageUs / tier.hop;
+
+  if (amortizedUs > m_budgetUs)
+  {
+    m_underBudget = 0;
+    if (++m_overBudget >= GOVERNOR_STEP_DOWN && m_activeTier + 1 < static_cast<int>(m_tiers.size()))
+    {
+      m_activeTier++;
+      m_overBudget = 0;
+      m_averageUs = 0.0;
+      return true;
+    }
+  }
+  else if (m_activeTier > 0)
+  {
+    // Estimate the cost of the better tier from the ratio of work per callback
+    const AnalysisTier& better = m_tiers[m_activeTier - 1];
+    double estimatedUs = m_averageUs * better.fftSize / tier.fftSize / better.hop;
+
+    m_overBudget = 0;
+    if (estimatedUs < m_budgetUs * GOVERNOR_HEADROOM)
+    {
+      if (++m_underBudget >= GOVERNOR_STEP_UP)
+      {
+        m_activeTier--;
+        m_underBudget = 0;
+        m_averageUs = 0.0;
+        return true;
+      }
+    }
+    else
+    {
+      m_underBudget = 0;
+    }
+  }
+
+  return false;
+}
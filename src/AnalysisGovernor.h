@@ -0,0 +1,64 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// One step of analysis quality. Lower tiers are cheaper, but all of them
+// produce the same band layout in the audio texture.
+struct AnalysisTier
+{
+  unsigned int fftSize; // FFT points, must divide the audio buffer size
+  unsigned int hop;     // analyse every n-th AudioData callback
+  bool stereo;          // mix all channels or only take the first one
+};
+
+class CAnalysisGovernor
+{
+public:
+  CAnalysisGovernor(const std::vector<AnalysisTier>& tiers);
+
+  // Budget in microseconds per AudioData callback, 0 disables the governor
+  // and keeps the best tier.
+  void SetBudget(unsigned int budgetUs);
+  unsigned int Budget() const { return m_budgetUs; }
+
+  // Feed the measured analysis time of one callback. Returns true if the
+  // active tier was changed.
+  bool Measure(double elapsedUs);
+
+  int ActiveTier() const { return m_activeTier; }
+  const AnalysisTier& Tier() const { return m_tiers[m_activeTier]; }
+  double AverageUs() const { return m_averageUs; }
+
+  // Decide if the current callback should run the analysis at all (hop).
+  bool NextCallback();
+
+private:
+  const std::vector<AnalysisTier>& m_tiers;
+  std::atomic<int> m_activeTier;
+  unsigned int m_budgetUs = 0;
+  unsigned int m_callback = 0;
+  double m_averageUs = 0.0;
+  int m_overBudget = 0;
+  int m_underBudget = 0;
+};
@@ -0,0 +1,132 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "AnalysisState.h"
+
+#include <chrono>
+#include <new>
+#include <thread>
+
+namespace
+{
+
+// Set on the published slot until the reader took it
+const int SLOT_DIRTY = 4;
+
+size_t AlignUp(size_t size)
+{
+  return (size + CACHE_LINE_SIZE - 1) & ~static_cast<size_t>(CACHE_LINE_SIZE - 1);
+}
+
+// Same fields as the real control block, all on one cache line
+struct PackedControl
+{
+  int writeSlot = 0;
+  std::atomic<unsigned int> published{0};
+  std::atomic<int> middle{1};
+  int readSlot = 2;
+  unsigned int acquired = 0;
+};
+
+template<typename Control>
+void Publish(Control& control)
+{
+  control.writeSlot = control.middle.exchange(control.writeSlot | SLOT_DIRTY, std::memory_order_acq_rel) & ~SLOT_DIRTY;
+  control.published.store(control.published.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template<typename Control>
+bool Acquire(Control& control)
+{
+  if (!(control.middle.load(std::memory_order_relaxed) & SLOT_DIRTY))
+    return false;
+  control.readSlot = control.middle.exchange(control.readSlot, std::memory_order_acq_rel) & ~SLOT_DIRTY;
+  control.acquired++;
+  return true;
+}
+
+template<typename Control>
+double Contend(Control& control, double seconds)
+{
+  // The reader polls as fast as it can, only the writer's updates count
+  std::atomic<bool> stop{false};
+  std::thread reader([&]()
+  {
+    while (!stop.load(std::memory_order_relaxed))
+      Acquire(control);
+  });
+
+  auto start = std::chrono::high_resolution_clock::now();
+  auto end = start + std::chrono::duration<double>(seconds);
+  unsigned int updates = 0;
+  while (std::chrono::high_resolution_clock::now() < end)
+  {
+    for (int i = 0; i < 1000; i++)
+      Publish(control);
+    updates += 1000;
+  }
+  double elapsed = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+  stop = true;
+  reader.join();
+  return elapsed / updates;
+}
+
+}
+
+CAnalysisState::CAnalysisState(size_t samples, size_t bands)
+{
+  const size_t control = AlignUp(sizeof(Control));
+  const size_t pcm = AlignUp(samples * sizeof(float));
+  const size_t magnitudes = AlignUp(bands * sizeof(float));
+  const size_t rows = AlignUp(bands * 2);
+  m_bytes = control + pcm + magnitudes + rows * 3;
+
+  // new[] only guarantees the alignment of the largest scalar type
+  m_memory.reset(new uint8_t[m_bytes + CACHE_LINE_SIZE]());
+  uint8_t* block = m_memory.get();
+  block += AlignUp(reinterpret_cast<uintptr_t>(block)) - reinterpret_cast<uintptr_t>(block);
+
+  m_control = new (block) Control;
+  m_pcm = reinterpret_cast<float*>(block + control);
+  m_magnitudes = reinterpret_cast<float*>(block + control + pcm);
+  for (int i = 0; i < 3; i++)
+    m_rows[i] = block + control + pcm + magnitudes + rows * i;
+}
+
+void CAnalysisState::Publish()
+{
+  ::Publish(*m_control);
+}
+
+const uint8_t* CAnalysisState::Acquire()
+{
+  if (!::Acquire(*m_control))
+    return nullptr;
+  return m_rows[m_control->readSlot];
+}
+
+void CAnalysisState::MeasureContention(double seconds, double& isolatedNs, double& packedNs)
+{
+  CAnalysisState isolated(0, 0);
+  isolatedNs = Contend(*isolated.m_control, seconds);
+
+  PackedControl packed;
+  packedNs = Contend(packed, seconds);
+}
@@ -0,0 +1,86 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Assumed size of a cache line, 64 bytes on all current x86 and ARM cores
+#define CACHE_LINE_SIZE (64)
+
+// Analysis state shared by the audio thread (writer) and the render thread
+// (reader). All arrays live in one block, each one starting on its own cache
+// line. The texture rows are triple buffered: the writer fills its slot and
+// swaps it with the published one, the reader swaps the published one with
+// its own, neither waits for the other. The fields each side writes are on
+// separate cache lines so the two cores don't steal the lines from each
+// other while they work on unrelated data.
+class CAnalysisState
+{
+public:
+  CAnalysisState(size_t samples, size_t bands);
+
+  // Writer side
+  float* Pcm() { return m_pcm; }
+  float* Magnitudes() { return m_magnitudes; }
+  // Texture rows to fill, bands x 2, spectrum then waveform
+  uint8_t* WriteRows() { return m_rows[m_control->writeSlot]; }
+  void Publish();
+
+  // Reader side. Takes the newest published rows, nullptr if nothing was
+  // published since the last call.
+  const uint8_t* Acquire();
+  // Rows taken by the last Acquire()
+  const uint8_t* Rows() const { return m_rows[m_control->readSlot]; }
+
+  // Published and taken updates, the difference was never shown
+  unsigned int Published() const { return m_control->published.load(std::memory_order_relaxed); }
+  unsigned int Acquired() const { return m_control->acquired; }
+
+  size_t Bytes() const { return m_bytes; }
+
+  // Runs a writer and a reader thread on the slot protocol for the given
+  // time, once with the fields of each side on their own cache lines and
+  // once packed together. Returns the nanoseconds per update for both.
+  static void MeasureContention(double seconds, double& isolatedNs, double& packedNs);
+
+private:
+  struct Control
+  {
+    // Writer
+    alignas(CACHE_LINE_SIZE) int writeSlot = 0;
+    std::atomic<unsigned int> published{0};
+    // Both
+    alignas(CACHE_LINE_SIZE) std::atomic<int> middle{1};
+    // Reader
+    alignas(CACHE_LINE_SIZE) int readSlot = 2;
+    unsigned int acquired = 0;
+  };
+
+  size_t m_bytes;
+  std::unique_ptr<uint8_t[]> m_memory;
+  Control* m_control;
+  float* m_pcm;
+  float* m_magnitudes;
+  uint8_t* m_rows[3];
+};
@@ -0,0 +1,331 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CellRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// GLSL built-ins
+inline float Fract(float x)
+{
+  return x - std::floor(x);
+}
+
+inline float Mod(float x, float y)
+{
+  return x - y * std::floor(x / y);
+}
+
+inline float Sign(float x)
+{
+  return x > 0.0f ? 1.0f : (x < 0.0f ? -1.0f : 0.0f);
+}
+
+inline float Clamp(float x, float low, float high)
+{
+  return std::min(std::max(x, low), high);
+}
+
+inline float Smoothstep(float edge0, float edge1, float x)
+{
+  float t = Clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+  return t * t * (3.0f - 2.0f * t);
+}
+
+// h11() of fsCommonFunctionsNormal and fsCommonFunctionsLowPower
+inline float Hash(float p, bool lowpower)
+{
+  if (lowpower)
+    return Fract(Fract(p * .1031f) * (p + 33.33f));
+  return Fract(20.12345f + std::sin(p * 170.12f) * 7572.1f);
+}
+
+} // namespace
+
+CCellRenderer::CCellRenderer(CThreadPool& pool)
+  : m_pool(pool)
+{
+}
+
+CCellRenderer::~CCellRenderer()
+{
+  m_tasks.Wait();
+}
+
+void CCellRenderer::Configure(const Setup& setup)
+{
+  m_tasks.Wait();
+  m_started = false;
+  m_setup = setup;
+
+  const size_t cells = static_cast<size_t>(setup.width) * setup.height;
+  m_columnU.resize(setup.width);
+  m_columnRnd.resize(setup.width);
+  m_rowV.resize(setup.height);
+  m_vignette.resize(cells);
+  m_rain.resize(cells);
+  m_imageScale.assign(cells, 1.0f);
+  m_imageOffset.assign(cells, 0.0f);
+  m_boost.assign(cells, 1.0f);
+  m_wave.assign(cells, 0.0f);
+  m_noise.assign(cells, 1.0f);
+  m_cells.assign(cells, 0);
+  m_audio.assign(setup.bands * 2, 0);
+
+  // Everything that only depends on the position
+  for (int x = 0; x < setup.width; x++)
+  {
+    float gv = static_cast<float>(x + setup.offsetX);
+    m_columnU[x] = (gv + 0.5f) / setup.columns;
+    m_columnRnd[x] = Hash(gv, setup.lowpower) + 0.1f;
+  }
+  for (int y = 0; y < setup.height; y++)
+    m_rowV[y] = (static_cast<float>(y + setup.offsetY) + 0.5f) / setup.columns;
+  for (int y = 0; y < setup.height; y++)
+  {
+    for (int x = 0; x < setup.width; x++)
+      m_vignette[y * setup.width + x] = std::sqrt(m_columnU[x] * m_columnU[x] + m_rowV[y] * m_rowV[y]) * setup.program.vignette;
+  }
+}
+
+size_t CCellRenderer::Bytes() const
+{
+  size_t bytes = m_audio.size() + m_cells.size();
+  for (const auto* buffer : {&m_columnU, &m_columnRnd, &m_rowV, &m_vignette, &m_rain, &m_imageScale,
+                             &m_imageOffset, &m_boost, &m_wave, &m_noise})
+    bytes += buffer->size() * sizeof(float);
+  for (const auto& image : m_images)
+    bytes += static_cast<size_t>(image.Width()) * image.Height() * 4;
+  return bytes;
+}
+
+void CCellRenderer::SetImage(int channel, const CImage& image)
+{
+  m_tasks.Wait();
+  m_images[channel] = image;
+}
+
+void CCellRenderer::Start(const Frame& frame)
+{
+  m_tasks.Wait();
+  m_frame = frame;
+  if (frame.audio)
+    std::copy(frame.audio, frame.audio + m_audio.size(), m_audio.begin());
+  m_frame.audio = nullptr;
+
+  // A few bands per thread to even out rows of different cost
+  const int bands = static_cast<int>(m_pool.Threads()) * 2;
+  const int rows = (m_setup.height + bands - 1) / bands;
+  for (int begin = 0; begin < m_setup.height; begin += rows)
+  {
+    int end = std::min(begin + rows, m_setup.height);
+    m_tasks.Run(m_pool, [this, begin, end] { ComputeRows(begin, end); });
+  }
+  m_started = true;
+}
+
+const uint8_t* CCellRenderer::Finish()
+{
+  if (!m_started)
+    return nullptr;
+
+  m_tasks.Wait();
+  m_started = false;
+  return m_cells.data();
+}
+
+float CCellRenderer::Audio(float x, int row) const
+{
+  // GL_LINEAR with GL_CLAMP_TO_EDGE along the row
+  const int bands = m_setup.bands;
+  float position = x * bands - 0.5f;
+  int left = static_cast<int>(std::floor(position));
+  float fraction = position - left;
+  int right = std::min(std::max(left + 1, 0), bands - 1);
+  left = std::min(std::max(left, 0), bands - 1);
+  const uint8_t* data = m_audio.data() + row * bands;
+  return (data[left] + (data[right] - data[left]) * fraction) / 255.0f;
+}
+
+void CCellRenderer::ComputeRows(int begin, int end)
+{
+  const CPresetCompiler::CellProgram& program = m_setup.program;
+  const int width = m_setup.width;
+  const float time = m_frame.time;
+
+  for (int y = begin; y < end; y++)
+  {
+    const float v = m_rowV[y];
+    const float gvY = static_cast<float>(y + m_setup.offsetY);
+    float* rain = m_rain.data() + y * width;
+    float* imageScale = m_imageScale.data() + y * width;
+    float* imageOffset = m_imageOffset.data() + y * width;
+    float* boost = m_boost.data() + y * width;
+    float* wave = m_wave.data() + y * width;
+    float* noise = m_noise.data() + y * width;
+    const float* vignette = m_vignette.data() + y * width;
+    uint8_t* cells = m_cells.data() + y * width;
+
+    // Rain phase
+    for (int x = 0; x < width; x++)
+      rain[x] = program.rainBase - Fract(gvY * .0024f + time * m_columnRnd[x]);
+
+    // The VHS distortion only depends on the row
+    float wav = 0.0f;
+    float distort = 0.0f;
+    if (program.distortion)
+    {
+      wav = Audio((v + 1.0f) * 0.5f, 1) - 0.5f;
+      distort = Sign(wav) * std::max(std::abs(wav) - m_setup.distortThreshold, 0.0f);
+    }
+    const float distortAbs = std::abs(distort);
+
+    // Logo or album
+    if (program.image != CPresetCompiler::IMAGE_NONE)
+    {
+      const float fill = .9f - wav * .2f;
+      const float shadow = (wav + 0.5f) * 0.25f;
+      const float glow = program.logoShadow * (1.0f - 2.0f * wav);
+      const float edge = static_cast<float>(LOGO_EDGE);
+      const float lines = 1.0f - (Mod(gvY * Sign(wav), 2.0f) * 10.0f * distortAbs + 5.0f * distortAbs);
+      for (int x = 0; x < width; x++)
+      {
+        const float u = m_columnU[x];
+        float tex;
+        if (program.image == CPresetCompiler::IMAGE_LOGO)
+        {
+          const float dist = (0.5f - m_images[CHANNEL_LOGO].Sample(u + 0.5f - distort * 0.6f, v + 0.5f - distort * 0.4f, 0, false)) *
+                             static_cast<float>(2.0 * LOGO_SDF_SPREAD);
+          tex = (1.0f - Smoothstep(-edge, edge, dist)) * fill;
+          if (glow > 0.0f)
+            tex = std::max(tex, glow * (1.0f - Smoothstep(0.0f, static_cast<float>(LOGO_SHADOW_WIDTH), dist)));
+          if (program.logoOutline > 0.0f)
+          {
+            const float ring = std::abs(dist - 1.5f * program.logoOutline) - 0.5f * program.logoOutline;
+            tex = std::max(tex, (1.0f - Smoothstep(-edge, edge, ring)) * fill);
+          }
+        }
+        else
+        {
+          const float* position = m_frame.albumPosition;
+          float s = u * position[2] + position[0] - distort * 0.6f;
+          float t = v * position[2] + position[1] - distort * 0.4f;
+          tex = 0.0f;
+          if (s >= 0.0f && s < 1.0f && t >= 0.0f && t < 1.0f)
+          {
+            const CImage& album = m_images[CHANNEL_ALBUM];
+            for (int c = 0; c < 3; c++)
+              tex += album.Sample(s, t, c, false) * m_frame.albumRGB[c];
+          }
+          tex *= fill;
+          tex = (std::max(shadow, tex) - shadow) / (1.0f - shadow);
+        }
+        tex *= lines;
+
+        if (program.image == CPresetCompiler::IMAGE_LOGO)
+        {
+          imageScale[x] = tex * .7f + .1f;
+          imageOffset[x] = distortAbs * .2f;
+        }
+        else
+        {
+          imageScale[x] = std::max(tex, 0.075f);
+          imageOffset[x] = std::min(distortAbs * .7f, .0105f);
+        }
+      }
+    }
+
+    // FFT boost
+    if (program.fft)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        const float u = m_columnU[x];
+        float fft = Audio((1.0f - std::abs(program.fftDistorted ? u - distort * .2f : u)) * .7f, 0);
+        if (program.fftBoost)
+          fft *= 4.32f - std::abs(u) * 1.755f;
+        else
+          fft -= std::abs(u) * .25f;
+        float gain = 1.0f + fft * 0.4f;
+        gain *= 1.0f + Clamp((fft * 1.3f) * (fft * 1.3f) - 12.0f, 0.0f, 0.6f);
+        gain *= 1.0f + Clamp(fft * fft * fft - 23.0f, 0.0f, 0.7f);
+        boost[x] = gain;
+      }
+    }
+
+    // Waveform or its envelope
+    if (program.waveform)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        const float u = m_columnU[x];
+        if (m_setup.lowpower)
+          wave[x] = std::min(std::abs(v * 20.0f + (Audio(u * .15f + .5f, 1) - .5f) * 10.0f), 0.5f);
+        else
+          wave[x] = std::abs(Smoothstep(.225f, .275f, Audio(u * .15f + .5f, 1) * .5f + v) - .5f);
+      }
+    }
+    else if (program.envelopeLimit >= 0.0f)
+    {
+      for (int x = 0; x < width; x++)
+        wave[x] = std::min(program.envelopeLimit, std::abs(v * Audio(m_columnU[x] * .5f + .5f, 1)) * 50.0f);
+    }
+
+    // Noise texture
+    if (program.noise)
+    {
+      const CImage& image = m_images[CHANNEL_NOISE];
+      for (int x = 0; x < width; x++)
+      {
+        float s, t;
+        if (m_setup.lowpower)
+        {
+          // NOISE_COORD at the cell center
+          const float scale = 1.0f / (256.0f * m_setup.dotSize);
+          s = (m_columnU[x] * m_setup.resolutionY + 0.5f * m_setup.resolutionX) * scale;
+          t = (v * m_setup.resolutionY + 0.5f * m_setup.resolutionY) * scale;
+        }
+        else
+        {
+          const float shift = time * m_setup.noiseFluctuation;
+          s = static_cast<float>(x + m_setup.offsetX) * .035431f + shift;
+          t = gvY * .035431f + shift;
+        }
+        noise[x] = image.Sample(s, t, 0, true);
+      }
+    }
+
+    // Combine and encode
+    const float limit = program.fftLimit > 0.0f ? program.fftLimit : CELL_INTENSITY_RANGE;
+    const float scale = 1.0f / CELL_INTENSITY_RANGE;
+    for (int x = 0; x < width; x++)
+    {
+      float bw = (rain[x] * imageScale[x] + imageOffset[x]) * boost[x];
+      bw = std::min(bw, limit);
+      bw = ((bw - wave[x]) * noise[x] - vignette[x]) * program.intensity;
+      bw = Clamp(bw * scale, 0.0f, 1.0f);
+      cells[x] = static_cast<uint8_t>(std::sqrt(bw) * 255.0f + 0.5f);
+    }
+  }
+}
@@ -0,0 +1,112 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "Image.h"
+#include "PresetCompiler.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+// Computes the intensity of every cell (dot) of a preset on the CPU, the
+// same math as the generated shader evaluated at the cell centers. The
+// result is one byte per cell for an R8 texture, see CELL_INTENSITY_RANGE.
+//
+// Start() splits the rows among the pool threads and returns, Finish()
+// waits for them. Starting the next frame right after uploading the
+// current one lets the computation overlap with the draw.
+class CCellRenderer
+{
+public:
+  struct Setup
+  {
+    CPresetCompiler::CellProgram program;
+    int width = 0; // cells
+    int height = 0;
+    int offsetX = 0; // gv of the first cell
+    int offsetY = 0;
+    float columns = 1.0f; // cColumns
+    float resolutionX = 1.0f;
+    float resolutionY = 1.0f;
+    float dotSize = 1.0f;
+    float noiseFluctuation = 0.0f;
+    float distortThreshold = 0.0f;
+    bool lowpower = false;
+    int bands = 0; // width of the audio data
+  };
+
+  // Inputs of one frame, copied by Start()
+  struct Frame
+  {
+    float time = 0.0f;
+    const uint8_t* audio = nullptr; // bands x 2, spectrum then waveform
+    float albumPosition[3] = {0.0f, 0.0f, 2.0f};
+    float albumRGB[3] = {0.0f, 0.0f, 0.0f};
+  };
+
+  enum Channel
+  {
+    CHANNEL_LOGO = 1,
+    CHANNEL_NOISE = 2,
+    CHANNEL_ALBUM = 3,
+  };
+
+  explicit CCellRenderer(CThreadPool& pool);
+  ~CCellRenderer();
+
+  void Configure(const Setup& setup);
+  void SetImage(int channel, const CImage& image);
+
+  void Start(const Frame& frame);
+  const uint8_t* Finish(); // nullptr if nothing was started
+  bool Started() const { return m_started; }
+
+  const Setup& GetSetup() const { return m_setup; }
+  // Memory of the buffers and the image copies
+  size_t Bytes() const;
+
+private:
+  void ComputeRows(int begin, int end);
+  float Audio(float x, int row) const;
+
+  CThreadPool& m_pool;
+  CTaskGroup m_tasks;
+  bool m_started = false;
+
+  Setup m_setup;
+  Frame m_frame;
+  std::vector<uint8_t> m_audio;
+  CImage m_images[4];
+
+  // Structure of arrays, per column, per row and per cell
+  std::vector<float> m_columnU;
+  std::vector<float> m_columnRnd;
+  std::vector<float> m_rowV;
+  std::vector<float> m_vignette;
+  std::vector<float> m_rain;
+  std::vector<float> m_imageScale;
+  std::vector<float> m_imageOffset;
+  std::vector<float> m_boost;
+  std::vector<float> m_wave;
+  std::vector<float> m_noise;
+  std::vector<uint8_t> m_cells;
+};
@@ -0,0 +1,276 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Checkerboard.h"
+
+#include <kodi/General.h>
+
+// Longest time step reprojected, the previous frame is too old beyond it
+#define CHECKERBOARD_MAX_STEP (0.1f)
+
+namespace
+{
+
+// The cell value is the brightness with the dot shape divided out, bw2col()
+// is linear in it for all presets. The dots don't move, only the rain runs
+// down the columns as 'base - fract(gv.y*.0024 + iTime*(h11(gv.x) + .1))',
+// see CPresetCompiler. The value of the previous frame is scaled by the
+// change of the rain in between, that also follows the drops wrapping
+// around. Whatever else changed is limited by the neighbours.
+const std::string g_resolveMain =
+R"resolve(
+uniform sampler2D iCurrent;
+uniform sampler2D iPrevious;
+uniform float iTimeStep;
+uniform float iTemporal;
+
+vec3 fetchHalf(sampler2D image, vec2 pixel)
+{
+  return texture(image, vec2(floor(pixel.x*.5)+.5, pixel.y+.5)/cHalfSize).rgb;
+}
+
+float cellValue(vec3 col, vec2 uv)
+{
+  return dot(col, vec3(1.))/max(dot(bw2col(1., uv), vec3(1.)), .001);
+}
+
+float rainAt(vec2 gv, float time)
+{
+  return cRainBase - fract((gv.y*.0024)+time*(h11(gv.x) + 0.1));
+}
+
+void main(void)
+{
+  vec2 pixel = floor(gl_FragCoord.xy);
+  vec2 uv = (gl_FragCoord.xy-0.5*iResolution.xy)/iResolution.y;
+  if (mod(pixel.x+pixel.y+iParity, 2.) < .5)
+  {
+    FragColor = vec4(fetchHalf(iCurrent, pixel), 1.);
+    return;
+  }
+
+  float px = 1./iResolution.y;
+  vec3 left = fetchHalf(iCurrent, pixel-vec2(1.,0.));
+  vec3 right = fetchHalf(iCurrent, pixel+vec2(1.,0.));
+  vec3 down = fetchHalf(iCurrent, pixel-vec2(0.,1.));
+  vec3 up = fetchHalf(iCurrent, pixel+vec2(0.,1.));
+  float l = cellValue(left, uv-vec2(px,0.));
+  float r = cellValue(right, uv+vec2(px,0.));
+  float d = cellValue(down, uv-vec2(0.,px));
+  float u = cellValue(up, uv+vec2(0.,px));
+  vec3 spatial = (left+right)*.5;
+
+  vec2 gv = floor(uv*cColumns);
+  float before = rainAt(gv, iTime-iTimeStep);
+  float value = cellValue(fetchHalf(iPrevious, pixel), uv);
+  if (abs(before) > .05)
+    value *= rainAt(gv, iTime)/before;
+  value = clamp(value, min(min(l,r),min(d,u)), max(max(l,r),max(d,u)));
+
+  FragColor = vec4(mix(spatial, bw2col(value, uv), iTemporal), 1.);
+}
+)resolve";
+
+}
+
+CCheckerboard::CCheckerboard(CGLDeletionQueue& deletionQueue)
+  : m_deletionQueue(deletionQueue),
+    m_resolve(new kodi::gui::gl::CShaderProgram)
+{
+}
+
+CCheckerboard::~CCheckerboard()
+{
+  Unload();
+}
+
+size_t CCheckerboard::Bytes(int width, int height)
+{
+  return 2 * static_cast<size_t>((width + 1) / 2) * height * 4;
+}
+
+std::string CCheckerboard::Defines()
+{
+  // Texel x of the half width target is pixel 2x of its row if the row and
+  // the parity are both even or both odd, else pixel 2x+1
+  std::string defines = "uniform float iParity;\n";
+#if defined(HAS_GL)
+  defines += "#define CHECKER_COORD vec2(floor(gl_FragCoord.x)*2.+mod(floor(gl_FragCoord.y)+iParity,2.)+.5,gl_FragCoord.y)\n";
+  defines += "#undef FRAG_UV\n";
+  defines += "#define FRAG_UV ((CHECKER_COORD-0.5*iResolution.xy)/iResolution.y)\n";
+  defines += "#undef NOISE_COORD\n";
+  defines += "#define NOISE_COORD (CHECKER_COORD/(256.*iDotSize))\n";
+#else
+  // The varyings are interpolated over the half width target, they are
+  // half a pixel off from the shaded pixel. Only the dot position needs it
+  // exact.
+  defines += "#undef FRAG_UV\n";
+  defines += "#define FRAG_UV (vUV+vec2((mod(floor(gl_FragCoord.y)+iParity,2.)-.5)/iResolution.y,0.))\n";
+#endif
+  return defines;
+}
+
+bool CCheckerboard::Load(int width, int height, float rainBase, const std::string& vertexShader,
+                         const std::string& fragmentShader, const std::string& vertexDefines, const std::string& defines)
+{
+  Unload();
+
+  m_width = (width + 1) / 2;
+  m_height = height;
+  std::string constants = "const vec2 cHalfSize = vec2(" + std::to_string(m_width) + ".," + std::to_string(m_height) + ".);\n";
+  constants += "const float cRainBase = " + std::to_string(rainBase) + ";\n";
+  if (!m_resolve->LoadShaderFiles(vertexShader, fragmentShader) ||
+      !m_resolve->CompileAndLink(vertexDefines, "", defines, constants + g_resolveMain))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to compile the checkerboard resolve shader");
+    return false;
+  }
+
+  GLuint program = m_resolve->ProgramHandle();
+  m_currentLoc = glGetUniformLocation(program, "iCurrent");
+  m_previousLoc = glGetUniformLocation(program, "iPrevious");
+  m_parityLoc = glGetUniformLocation(program, "iParity");
+  m_timeLoc = glGetUniformLocation(program, "iTime");
+  m_timeStepLoc = glGetUniformLocation(program, "iTimeStep");
+  m_temporalLoc = glGetUniformLocation(program, "iTemporal");
+  m_dotLUTLoc = glGetUniformLocation(program, "iDotLUT");
+  m_vertexLoc = glGetAttribLocation(program, "vertex");
+
+  Create(m_targets[0]);
+  m_current = &m_targets[0];
+  return true;
+}
+
+void CCheckerboard::Unload()
+{
+  for (auto& targets : m_targets)
+    Delete(targets);
+  m_current = &m_targets[0];
+  m_resolve.reset(new kodi::gui::gl::CShaderProgram);
+}
+
+void CCheckerboard::Create(Targets& targets)
+{
+  glActiveTexture(GL_TEXTURE0);
+  for (int i = 0; i < 2; i++)
+  {
+    glGenTextures(1, &targets.textures[i]);
+    glBindTexture(GL_TEXTURE_2D, targets.textures[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &targets.framebuffers[i]);
+    glBindFramebuffer(GL_FRAMEBUFFER, targets.framebuffers[i]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets.textures[i], 0);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  // The first frame has no previous one
+  targets.frame = 0;
+}
+
+void CCheckerboard::Delete(Targets& targets)
+{
+  for (int i = 0; i < 2; i++)
+  {
+    m_deletionQueue.DeleteTexture(targets.textures[i]);
+    m_deletionQueue.DeleteFramebuffer(targets.framebuffers[i]);
+    targets.textures[i] = 0;
+    targets.framebuffers[i] = 0;
+  }
+}
+
+void CCheckerboard::Forget()
+{
+  // See CVisualizationMatrix::ForgetGLResources()
+  m_resolve.release();
+  m_resolve.reset(new kodi::gui::gl::CShaderProgram);
+  for (auto& targets : m_targets)
+  {
+    for (int i = 0; i < 2; i++)
+    {
+      targets.textures[i] = 0;
+      targets.framebuffers[i] = 0;
+    }
+  }
+  m_current = &m_targets[0];
+}
+
+void CCheckerboard::Select(bool offscreen)
+{
+  m_current = &m_targets[offscreen ? 1 : 0];
+  if (!m_current->framebuffers[0])
+    Create(*m_current);
+}
+
+void CCheckerboard::Begin()
+{
+  glGetIntegerv(GL_VIEWPORT, m_viewport);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_current->framebuffers[m_current->frame & 1]);
+  glViewport(0, 0, m_width, m_height);
+}
+
+void CCheckerboard::Resolve(GLuint framebuffer, GLuint vertexBuffer, float time, CheckerboardMode mode, GLuint dotLUT)
+{
+  const float step = time - m_current->lastTime;
+  const bool temporal = mode == CHECKERBOARD_TEMPORAL && m_current->frame > 0 && step >= 0.0f && step <= CHECKERBOARD_MAX_STEP;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
+
+  glUseProgram(m_resolve->ProgramHandle());
+  glUniform1f(m_parityLoc, static_cast<float>(Parity()));
+  glUniform1f(m_timeLoc, time);
+  glUniform1f(m_timeStepLoc, step);
+  glUniform1f(m_temporalLoc, temporal ? 1.0f : 0.0f);
+  glActiveTexture(GL_TEXTURE0);
+  glUniform1i(m_currentLoc, 0);
+  glBindTexture(GL_TEXTURE_2D, m_current->textures[m_current->frame & 1]);
+  glActiveTexture(GL_TEXTURE1);
+  glUniform1i(m_previousLoc, 1);
+  glBindTexture(GL_TEXTURE_2D, m_current->textures[(m_current->frame + 1) & 1]);
+  if (m_dotLUTLoc >= 0)
+  {
+    glActiveTexture(GL_TEXTURE4);
+    glUniform1i(m_dotLUTLoc, 4);
+    glBindTexture(GL_TEXTURE_2D, dotLUT);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  glVertexAttribPointer(m_vertexLoc, 4, GL_FLOAT, 0, 16, 0);
+  glEnableVertexAttribArray(m_vertexLoc);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+  glDisableVertexAttribArray(m_vertexLoc);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  for (int i : {0, 1, 4})
+  {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  glUseProgram(0);
+
+  m_current->lastTime = time;
+  m_current->frame++;
+}
@@ -0,0 +1,110 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "GLDeletionQueue.h"
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <memory>
+#include <string>
+
+enum CheckerboardMode
+{
+  CHECKERBOARD_OFF,
+  CHECKERBOARD_TEMPORAL, // missing pixels from the previous frame
+  CHECKERBOARD_SPATIAL,  // missing pixels from their neighbours, for comparison
+};
+
+// Shades half the pixels per frame in an alternating checkerboard. The
+// preset draws into a half width target, each texel stands for the pixel
+// of its row that is shaded this frame, see Defines(). The resolve pass
+// rebuilds the full image: the other half was shaded by the previous frame,
+// its brightness is carried forward with the known motion of the rain and
+// limited to the range of the neighbours shaded now. The dot shape is taken
+// from bw2col() of the preset, so the rebuilt pixels keep it sharp.
+class CCheckerboard
+{
+public:
+  explicit CCheckerboard(CGLDeletionQueue& deletionQueue);
+  ~CCheckerboard();
+
+  // Bytes of the targets for a width x height image
+  static size_t Bytes(int width, int height);
+
+  // Header lines of the preset for the half width target, before the
+  // functions which use FRAG_UV and NOISE_COORD
+  static std::string Defines();
+
+  // Creates the targets and the resolve program, built from the same files
+  // and headers as the preset. The rain base is the one of the preset.
+  bool Load(int width, int height, float rainBase, const std::string& vertexShader,
+            const std::string& fragmentShader, const std::string& vertexDefines, const std::string& defines);
+  void Unload();
+  // Drops the GL objects without deleting, for a lost context
+  void Forget();
+  bool Loaded() const { return m_targets[0].framebuffers[0] != 0; }
+
+  // Switches between the targets of the visible frames and those of the
+  // offscreen ones (benchmark, still images). Each keeps its own parity and
+  // previous frame, so frames drawn in between don't disturb the other. The
+  // offscreen targets are created on first use.
+  void Select(bool offscreen);
+
+  // Parity of the pixels shaded this frame, the preset's iParity
+  int Parity() const { return m_current->frame & 1; }
+
+  // Binds the target of this frame with its viewport
+  void Begin();
+  // Rebuilds the full image into framebuffer. Time is the preset's iTime,
+  // the dot LUT is needed if the preset uses it.
+  void Resolve(GLuint framebuffer, GLuint vertexBuffer, float time, CheckerboardMode mode, GLuint dotLUT);
+
+private:
+  // Half width targets of the current and the previous frame
+  struct Targets
+  {
+    GLuint textures[2] = {0};
+    GLuint framebuffers[2] = {0};
+    unsigned int frame = 0;
+    float lastTime = 0.0f;
+  };
+
+  void Create(Targets& targets);
+  void Delete(Targets& targets);
+
+  CGLDeletionQueue& m_deletionQueue;
+  std::unique_ptr<kodi::gui::gl::CShaderProgram> m_resolve;
+  Targets m_targets[2]; // visible, offscreen
+  Targets* m_current = &m_targets[0];
+  int m_width = 0;
+  int m_height = 0;
+  GLint m_viewport[4] = {0};
+
+  GLint m_currentLoc = -1;
+  GLint m_previousLoc = -1;
+  GLint m_parityLoc = -1;
+  GLint m_timeLoc = -1;
+  GLint m_timeStepLoc = -1;
+  GLint m_temporalLoc = -1;
+  GLint m_dotLUTLoc = -1;
+  GLint m_vertexLoc = -1;
+};
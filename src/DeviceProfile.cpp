@@ -0,0 +1,145 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "DeviceProfile.h"
+
+#include <kodi/Filesystem.h>
+#include <kodi/General.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+CDeviceProfile::CDeviceProfile(const std::string& file)
+  : m_file(file)
+{
+}
+
+bool CDeviceProfile::Load()
+{
+  m_values.clear();
+
+  kodi::vfs::CFile file;
+  if (!kodi::vfs::FileExists(m_file) || !file.OpenFile(m_file))
+    return false;
+
+  std::string line;
+  while (file.ReadLine(line))
+  {
+    size_t pos = line.find('=');
+    if (pos == std::string::npos || line[0] == '#')
+      continue;
+    m_values[line.substr(0, pos)] = line.substr(pos + 1);
+  }
+  file.Close();
+  return true;
+}
+
+bool CDeviceProfile::Save()
+{
+  std::string directory = m_file.substr(0, m_file.find_last_of("/\\") + 1);
+  if (!kodi::vfs::DirectoryExists(directory))
+    kodi::vfs::CreateDirectory(directory);
+
+  kodi::vfs::CFile file;
+  if (!file.OpenFileForWrite(m_file, true))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to write device profile '%s'", m_file.c_str());
+    return false;
+  }
+
+  for (const auto& value : m_values)
+  {
+    std::string line = value.first + "=" + value.second + "\n";
+    file.Write(line.c_str(), line.size());
+  }
+  file.Close();
+  return true;
+}
+
+bool CDeviceProfile::Has(const std::string& key) const
+{
+  return m_values.find(key) != m_values.end();
+}
+
+std::string CDeviceProfile::Get(const std::string& key, const std::string& fallback) const
+{
+  auto it = m_values.find(key);
+  return it != m_values.end() ? it->second : fallback;
+}
+
+void CDeviceProfile::Set(const std::string& key, const std::string& value)
+{
+  m_values[key] = value;
+}
+
+void CDeviceProfile::Remove(const std::string& key)
+{
+  m_values.erase(key);
+}
+
+std::string CDeviceProfile::CPUModel()
+{
+  // x86 reports "model name", ARM only "Hardware" and the core type as "CPU part"
+  std::string model;
+  std::string hardware;
+  std::string part;
+
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line))
+  {
+    size_t pos = line.find(':');
+    if (pos == std::string::npos)
+      continue;
+
+    std::string key = line.substr(0, line.find_last_not_of(" \t", pos - 1) + 1);
+    std::string value = line.substr(std::min(line.size(), pos + 2));
+    if (key == "model name" && model.empty())
+      model = value;
+    else if (key == "Hardware" && hardware.empty())
+      hardware = value;
+    else if (key == "CPU part" && part.empty())
+      part = value;
+  }
+
+  std::string cpu = !model.empty() ? model : hardware;
+  if (!part.empty())
+    cpu += " part " + part;
+  if (cpu.empty())
+    cpu = "unknown";
+
+  // Keys must not contain the separator
+  std::replace(cpu.begin(), cpu.end(), '=', '_');
+  return cpu;
+}
+
+size_t CDeviceProfile::ResidentMemory()
+{
+  // Linux and Android, in kB
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 6, "VmRSS:") == 0)
+      return static_cast<size_t>(std::strtoull(line.c_str() + 6, nullptr, 10)) * 1024;
+  }
+  return 0;
+}
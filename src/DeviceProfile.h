@@ -0,0 +1,50 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+// Small key/value store in the add-on profile directory. It keeps results
+// that are expensive to measure and only valid for one device, e.g. the
+// fastest FFT engine for the CPU.
+class CDeviceProfile
+{
+public:
+  CDeviceProfile(const std::string& file);
+
+  bool Load();
+  bool Save();
+
+  bool Has(const std::string& key) const;
+  std::string Get(const std::string& key, const std::string& fallback = "") const;
+  void Set(const std::string& key, const std::string& value);
+  void Remove(const std::string& key);
+
+  // Identification of the hardware, used as part of the keys
+  static std::string CPUModel();
+  // Resident memory of the whole process in bytes, 0 where unknown
+  static size_t ResidentMemory();
+
+private:
+  std::string m_file;
+  std::map<std::string, std::string> m_values;
+};
@@ -0,0 +1,127 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "DirtyRows.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIRTY_ROWS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DIRTY_ROWS_NEON
+#endif
+
+namespace
+{
+
+const int BLOCK = 16;
+
+bool BlockEqual(const uint8_t* a, const uint8_t* b)
+{
+#if defined(DIRTY_ROWS_SSE2)
+  const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+  return _mm_movemask_epi8(equal) == 0xFFFF;
+#elif defined(DIRTY_ROWS_NEON)
+  // No horizontal minimum on 32 bit ARM, the two halves as 64 bit lanes
+  const uint64x2_t equal = vreinterpretq_u64_u8(vceqq_u8(vld1q_u8(a), vld1q_u8(b)));
+  return (vgetq_lane_u64(equal, 0) & vgetq_lane_u64(equal, 1)) == ~static_cast<uint64_t>(0);
+#else
+  return std::memcmp(a, b, BLOCK) == 0;
+#endif
+}
+
+} // namespace
+
+CDirtyRows::CDirtyRows(int width, int height, int ring)
+  : m_width(width),
+    m_height(height),
+    m_slots(ring, std::vector<uint8_t>(width * height))
+{
+}
+
+void CDirtyRows::Reset(const uint8_t* rows)
+{
+  for (auto& slot : m_slots)
+    slot.assign(rows, rows + m_width * m_height);
+}
+
+bool CDirtyRows::Unchanged(int slot, const uint8_t* rows)
+{
+  int begin, end;
+  if (Diff(m_slots[slot].data(), rows, m_width * m_height, begin, end))
+    return false;
+
+  m_skipped++;
+  m_offeredBytes += m_width * m_height;
+  return true;
+}
+
+bool CDirtyRows::Update(int slot, const uint8_t* rows, std::vector<Span>& spans)
+{
+  uint8_t* contents = m_slots[slot].data();
+  spans.resize(m_height);
+  size_t bytes = 0;
+  for (int y = 0; y < m_height; y++)
+  {
+    Span& span = spans[y];
+    const int offset = y * m_width;
+    if (!Diff(contents + offset, rows + offset, m_width, span.begin, span.end))
+      span.begin = span.end = 0;
+    bytes += span.end - span.begin;
+  }
+  std::memcpy(contents, rows, m_width * m_height);
+
+  m_offeredBytes += m_width * m_height;
+  if (bytes == static_cast<size_t>(m_width) * m_height)
+  {
+    m_full++;
+    m_uploadedBytes += bytes;
+    return false;
+  }
+  m_partial++;
+  m_uploadedBytes += bytes;
+  return true;
+}
+
+bool CDirtyRows::Diff(const uint8_t* a, const uint8_t* b, int size, int& begin, int& end)
+{
+  // Whole blocks from the front, then the bytes of the first differing one
+  int first = 0;
+  while (first + BLOCK <= size && BlockEqual(a + first, b + first))
+    first += BLOCK;
+  while (first < size && a[first] == b[first])
+    first++;
+  if (first == size)
+    return false;
+
+  // Same from the back, down to the first difference at most
+  int last = size;
+  while (last - BLOCK >= first && BlockEqual(a + last - BLOCK, b + last - BLOCK))
+    last -= BLOCK;
+  while (a[last - 1] == b[last - 1])
+    last--;
+
+  begin = first;
+  end = last;
+  return true;
+}
@@ -0,0 +1,71 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keeps a copy of what each texture of a ring holds, so an update only has
+// to upload the bytes that differ from it. Rows are compared in 16 byte
+// blocks with SSE2 or NEON where available.
+class CDirtyRows
+{
+public:
+  // Changed bytes of one row, [begin, end), empty if begin == end
+  struct Span
+  {
+    int begin = 0;
+    int end = 0;
+  };
+
+  CDirtyRows(int width, int height, int ring);
+
+  // All textures of the ring were created with these rows
+  void Reset(const uint8_t* rows);
+
+  // True if the rows are what the slot already holds, counted as skipped
+  bool Unchanged(int slot, const uint8_t* rows);
+
+  // Changed span of each row against the slot, which then holds the rows.
+  // Returns false if every row changed completely.
+  bool Update(int slot, const uint8_t* rows, std::vector<Span>& spans);
+
+  // First and one past the last byte that differ, false if none do
+  static bool Diff(const uint8_t* a, const uint8_t* b, int size, int& begin, int& end);
+
+  unsigned int Skipped() const { return m_skipped; }
+  unsigned int Partial() const { return m_partial; }
+  unsigned int Full() const { return m_full; }
+  // Uploaded bytes against the bytes of full uploads of all taken updates
+  size_t UploadedBytes() const { return m_uploadedBytes; }
+  size_t OfferedBytes() const { return m_offeredBytes; }
+
+private:
+  int m_width;
+  int m_height;
+  std::vector<std::vector<uint8_t>> m_slots;
+  unsigned int m_skipped = 0;
+  unsigned int m_partial = 0;
+  unsigned int m_full = 0;
+  size_t m_uploadedBytes = 0;
+  size_t m_offeredBytes = 0;
+};
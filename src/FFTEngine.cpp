@@ -0,0 +1,174 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FFTEngine.h"
+
+#include <kodi/General.h>
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+// Transforms per timing run and number of runs, the fastest run counts
+#define TUNE_ITERATIONS (200)
+#define TUNE_RUNS (5)
+// Maximum allowed deviation from the reference, relative to the peak bin
+#define TUNE_TOLERANCE (1e-4)
+
+CFFTEngineComplex::CFFTEngineComplex(unsigned int size)
+  : IFFTEngine(size),
+    m_cfg(kiss_fft_alloc(size, 0, nullptr, nullptr)),
+    m_input(size)
+{
+}
+
+CFFTEngineComplex::~CFFTEngineComplex()
+{
+  free(m_cfg);
+}
+
+void CFFTEngineComplex::Transform(const float* input, kiss_fft_cpx* output)
+{
+  for (unsigned int i = 0; i < m_size; i++)
+  {
+    m_input[i].r = input[i];
+    m_input[i].i = 0;
+  }
+  kiss_fft(m_cfg, m_input.data(), output);
+}
+
+CFFTEngineRealPacked::CFFTEngineRealPacked(unsigned int size)
+  : IFFTEngine(size),
+    m_cfg(kiss_fft_alloc(size / 2, 0, nullptr, nullptr)),
+    m_packed(size / 2),
+    m_spectrum(size / 2),
+    m_twiddles(size / 2)
+{
+  for (unsigned int k = 0; k < size / 2; k++)
+  {
+    double phase = -2.0 * M_PI * k / size;
+    m_twiddles[k].r = static_cast<float>(cos(phase));
+    m_twiddles[k].i = static_cast<float>(sin(phase));
+  }
+}
+
+CFFTEngineRealPacked::~CFFTEngineRealPacked()
+{
+  free(m_cfg);
+}
+
+void CFFTEngineRealPacked::Transform(const float* input, kiss_fft_cpx* output)
+{
+  const unsigned int half = m_size / 2;
+  for (unsigned int i = 0; i < half; i++)
+  {
+    m_packed[i].r = input[2 * i];
+    m_packed[i].i = input[2 * i + 1];
+  }
+  kiss_fft(m_cfg, m_packed.data(), m_spectrum.data());
+
+  // Z[k] = E[k] + i*O[k] with E, O the spectra of the even and odd samples,
+  // X[k] = E[k] + W^k * O[k]
+  for (unsigned int k = 0; k < half; k++)
+  {
+    const kiss_fft_cpx& z = m_spectrum[k];
+    const kiss_fft_cpx& zc = m_spectrum[k ? half - k : 0];
+
+    float er = 0.5f * (z.r + zc.r);
+    float ei = 0.5f * (z.i - zc.i);
+    float orr = 0.5f * (z.i + zc.i);
+    float oi = -0.5f * (z.r - zc.r);
+
+    const kiss_fft_cpx& w = m_twiddles[k];
+    output[k].r = er + w.r * orr - w.i * oi;
+    output[k].i = ei + w.r * oi + w.i * orr;
+  }
+  output[half].r = m_spectrum[0].r - m_spectrum[0].i;
+  output[half].i = 0;
+}
+
+std::vector<std::string> CFFTAutotuner::Candidates()
+{
+  return {"complex", "realpacked"};
+}
+
+std::unique_ptr<IFFTEngine> CFFTAutotuner::Create(const std::string& name, unsigned int size)
+{
+  if (name == "realpacked" && size % 2 == 0)
+    return std::unique_ptr<IFFTEngine>(new CFFTEngineRealPacked(size));
+  return std::unique_ptr<IFFTEngine>(new CFFTEngineComplex(size));
+}
+
+std::string CFFTAutotuner::Tune(unsigned int size)
+{
+  // Noise plus a tone, deterministic so runs are comparable
+  std::vector<float> input(size);
+  unsigned int seed = 1;
+  for (unsigned int i = 0; i < size; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    input[i] = static_cast<float>(sin(i * 0.3)) * 0.5f + ((seed >> 16) & 0x7fff) / 65536.0f - 0.25f;
+  }
+
+  std::vector<kiss_fft_cpx> reference(size);
+  CFFTEngineComplex(size).Transform(input.data(), reference.data());
+  float peak = 0.0f;
+  for (unsigned int k = 0; k <= size / 2; k++)
+    peak = std::max(peak, std::max(fabsf(reference[k].r), fabsf(reference[k].i)));
+
+  std::string best = "complex";
+  double bestTime = 0.0;
+  std::vector<kiss_fft_cpx> output(size);
+  for (const auto& name : Candidates())
+  {
+    std::unique_ptr<IFFTEngine> engine = Create(name, size);
+
+    engine->Transform(input.data(), output.data());
+    float error = 0.0f;
+    for (unsigned int k = 0; k <= size / 2; k++)
+      error = std::max(error, std::max(fabsf(output[k].r - reference[k].r), fabsf(output[k].i - reference[k].i)));
+    if (error > peak * TUNE_TOLERANCE)
+    {
+      kodi::Log(ADDON_LOG_WARNING, "FFT engine %s rejected for size %u, error %f", name.c_str(), size, error);
+      continue;
+    }
+
+    double fastest = 0.0;
+    for (int run = 0; run < TUNE_RUNS; run++)
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int i = 0; i < TUNE_ITERATIONS; i++)
+        engine->Transform(input.data(), output.data());
+      double elapsed = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / TUNE_ITERATIONS;
+      if (!run || elapsed < fastest)
+        fastest = elapsed;
+    }
+
+    kodi::Log(ADDON_LOG_DEBUG, "FFT engine %s size %u: %.2f us", name.c_str(), size, fastest);
+    if (bestTime == 0.0 || fastest < bestTime)
+    {
+      best = name;
+      bestTime = fastest;
+    }
+  }
+
+  return best;
+}
@@ -0,0 +1,89 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "kissfft/kiss_fft.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Forward FFT of a real, already windowed signal. Implementations only have
+// to fill the bins 0..size/2, the upper half is never read.
+class IFFTEngine
+{
+public:
+  IFFTEngine(unsigned int size) : m_size(size) {}
+  virtual ~IFFTEngine() = default;
+
+  virtual const char* Name() const = 0;
+  virtual void Transform(const float* input, kiss_fft_cpx* output) = 0;
+
+  unsigned int Size() const { return m_size; }
+
+protected:
+  unsigned int m_size;
+};
+
+// Plain complex kissfft with a zero imaginary part
+class CFFTEngineComplex : public IFFTEngine
+{
+public:
+  CFFTEngineComplex(unsigned int size);
+  ~CFFTEngineComplex() override;
+
+  const char* Name() const override { return "complex"; }
+  void Transform(const float* input, kiss_fft_cpx* output) override;
+
+private:
+  kiss_fft_cfg m_cfg;
+  std::vector<kiss_fft_cpx> m_input;
+};
+
+// Packs even and odd samples into one complex FFT of half the size and
+// splits the result afterwards
+class CFFTEngineRealPacked : public IFFTEngine
+{
+public:
+  CFFTEngineRealPacked(unsigned int size);
+  ~CFFTEngineRealPacked() override;
+
+  const char* Name() const override { return "realpacked"; }
+  void Transform(const float* input, kiss_fft_cpx* output) override;
+
+private:
+  kiss_fft_cfg m_cfg;
+  std::vector<kiss_fft_cpx> m_packed;
+  std::vector<kiss_fft_cpx> m_spectrum;
+  std::vector<kiss_fft_cpx> m_twiddles;
+};
+
+class CFFTAutotuner
+{
+public:
+  // All engines known for the given size
+  static std::vector<std::string> Candidates();
+  static std::unique_ptr<IFFTEngine> Create(const std::string& name, unsigned int size);
+
+  // Times every candidate and returns the name of the fastest one which
+  // matches the reference output
+  static std::string Tune(unsigned int size);
+};
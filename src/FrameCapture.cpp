@@ -0,0 +1,364 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FrameCapture.h"
+
+#include <kodi/Filesystem.h>
+#include <kodi/General.h>
+
+#include <cstring>
+
+namespace
+{
+
+const char g_magic[4] = {'M', 'T', 'X', 'F'};
+const uint32_t g_version = 2;
+
+// Components of the uniform types the presets use, 0 for others
+int Components(GLenum type, bool& integer)
+{
+  integer = false;
+  switch (type)
+  {
+    case GL_FLOAT:
+      return 1;
+    case GL_FLOAT_VEC2:
+      return 2;
+    case GL_FLOAT_VEC3:
+      return 3;
+    case GL_FLOAT_VEC4:
+      return 4;
+    case GL_INT:
+    case GL_BOOL:
+    case GL_SAMPLER_2D:
+      integer = true;
+      return 1;
+    case GL_INT_VEC2:
+    case GL_BOOL_VEC2:
+      integer = true;
+      return 2;
+    case GL_INT_VEC3:
+    case GL_BOOL_VEC3:
+      integer = true;
+      return 3;
+    case GL_INT_VEC4:
+    case GL_BOOL_VEC4:
+      integer = true;
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+// Length prefixed values in host byte order, captures are replayed on the
+// same kind of machine they were taken on or at least the same endianness
+class CWriter
+{
+public:
+  explicit CWriter(kodi::vfs::CFile& file) : m_file(file) {}
+
+  void Write(uint32_t value) { m_file.Write(&value, sizeof(value)); }
+  void Write(const std::string& value)
+  {
+    Write(static_cast<uint32_t>(value.size()));
+    m_file.Write(value.data(), value.size());
+  }
+  void Write(const void* data, size_t size)
+  {
+    Write(static_cast<uint32_t>(size));
+    m_file.Write(data, size);
+  }
+
+private:
+  kodi::vfs::CFile& m_file;
+};
+
+class CReader
+{
+public:
+  explicit CReader(kodi::vfs::CFile& file) : m_file(file) {}
+
+  bool Ok() const { return m_ok; }
+
+  uint32_t Read()
+  {
+    uint32_t value = 0;
+    m_ok = m_ok && m_file.Read(&value, sizeof(value)) == sizeof(value);
+    return m_ok ? value : 0;
+  }
+  std::string ReadString()
+  {
+    std::string value(Size(), '\0');
+    m_ok = m_ok && m_file.Read(&value[0], value.size()) == static_cast<ssize_t>(value.size());
+    return value;
+  }
+  template<typename T>
+  void ReadVector(std::vector<T>& value)
+  {
+    value.resize(Size() / sizeof(T));
+    m_ok = m_ok && m_file.Read(value.data(), value.size() * sizeof(T)) == static_cast<ssize_t>(value.size() * sizeof(T));
+  }
+
+private:
+  // Sizes are checked against the file, a damaged one must not make us
+  // allocate gigabytes
+  uint32_t Size()
+  {
+    uint32_t size = Read();
+    if (size > m_file.GetLength())
+      m_ok = false;
+    return m_ok ? size : 0;
+  }
+
+  kodi::vfs::CFile& m_file;
+  bool m_ok = true;
+};
+
+void WriteProgram(CWriter& writer, const CFrameCapture::Program& program)
+{
+  for (const std::string* source : {&program.vertexBegin, &program.vertex, &program.vertexEnd,
+                                    &program.fragmentBegin, &program.fragment, &program.fragmentEnd})
+    writer.Write(*source);
+  writer.Write(static_cast<uint32_t>(program.uniforms.size()));
+  for (const auto& uniform : program.uniforms)
+  {
+    writer.Write(uniform.name);
+    writer.Write(uniform.type);
+    writer.Write(uniform.values.data(), uniform.values.size() * sizeof(float));
+  }
+}
+
+void ReadProgram(CReader& reader, CFrameCapture::Program& program)
+{
+  for (std::string* source : {&program.vertexBegin, &program.vertex, &program.vertexEnd,
+                              &program.fragmentBegin, &program.fragment, &program.fragmentEnd})
+    *source = reader.ReadString();
+  uint32_t count = reader.Read();
+  for (uint32_t i = 0; i < count && reader.Ok(); i++)
+  {
+    CFrameCapture::Uniform uniform;
+    uniform.name = reader.ReadString();
+    uniform.type = reader.Read();
+    reader.ReadVector(uniform.values);
+    program.uniforms.push_back(std::move(uniform));
+  }
+}
+
+} // namespace
+
+size_t CFrameCapture::Program::Bytes() const
+{
+  return vertexBegin.size() + vertex.size() + vertexEnd.size() +
+         fragmentBegin.size() + fragment.size() + fragmentEnd.size();
+}
+
+std::string CFrameCapture::ReadSource(const std::string& file)
+{
+  kodi::vfs::CFile input;
+  if (!input.OpenFile(file))
+    return "";
+
+  std::string source;
+  std::string line;
+  while (input.ReadLine(line))
+    source += line + "\n";
+  input.Close();
+  return source;
+}
+
+void CFrameCapture::ReadUniforms(GLuint program, std::vector<Uniform>& uniforms)
+{
+  uniforms.clear();
+
+  GLint count = 0;
+  GLint maxLength = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<char> name(maxLength + 1);
+
+  for (GLint i = 0; i < count; i++)
+  {
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program, i, static_cast<GLsizei>(name.size()), nullptr, &size, &type, name.data());
+    bool integer;
+    int components = Components(type, integer);
+    if (!components)
+    {
+      kodi::Log(ADDON_LOG_WARNING, "Frame capture: skipping uniform %s of type 0x%x", name.data(), type);
+      continue;
+    }
+
+    // Arrays are reported by their first element
+    std::string base = name.data();
+    if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+      base.erase(base.size() - 3);
+
+    for (GLint element = 0; element < size; element++)
+    {
+      Uniform uniform;
+      uniform.name = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+      uniform.type = type;
+      GLint location = glGetUniformLocation(program, uniform.name.c_str());
+      if (location < 0)
+        continue;
+
+      if (integer)
+      {
+        GLint values[4] = {0, 0, 0, 0};
+        glGetUniformiv(program, location, values);
+        uniform.values.assign(values, values + components);
+      }
+      else
+      {
+        GLfloat values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glGetUniformfv(program, location, values);
+        uniform.values.assign(values, values + components);
+      }
+      uniforms.push_back(std::move(uniform));
+    }
+  }
+}
+
+void CFrameCapture::ApplyUniforms(GLuint program, const std::vector<Uniform>& uniforms)
+{
+  glUseProgram(program);
+  for (const auto& uniform : uniforms)
+  {
+    GLint location = glGetUniformLocation(program, uniform.name.c_str());
+    bool integer;
+    int components = Components(uniform.type, integer);
+    if (location < 0 || !components || static_cast<int>(uniform.values.size()) != components)
+      continue;
+
+    const float* v = uniform.values.data();
+    if (integer)
+    {
+      GLint i[4] = {0, 0, 0, 0};
+      for (int c = 0; c < components; c++)
+        i[c] = static_cast<GLint>(v[c]);
+      switch (components)
+      {
+        case 1: glUniform1i(location, i[0]); break;
+        case 2: glUniform2i(location, i[0], i[1]); break;
+        case 3: glUniform3i(location, i[0], i[1], i[2]); break;
+        default: glUniform4i(location, i[0], i[1], i[2], i[3]); break;
+      }
+    }
+    else
+    {
+      switch (components)
+      {
+        case 1: glUniform1f(location, v[0]); break;
+        case 2: glUniform2f(location, v[0], v[1]); break;
+        case 3: glUniform3f(location, v[0], v[1], v[2]); break;
+        default: glUniform4f(location, v[0], v[1], v[2], v[3]); break;
+      }
+    }
+  }
+  glUseProgram(0);
+}
+
+bool CFrameCapture::Save(const std::string& file) const
+{
+  kodi::vfs::CFile output;
+  if (!output.OpenFileForWrite(file, true))
+    return false;
+
+  output.Write(g_magic, sizeof(g_magic));
+  CWriter writer(output);
+  writer.Write(g_version);
+  writer.Write(renderer);
+  writer.Write(version);
+  writer.Write(preset);
+  writer.Write(width);
+  writer.Write(height);
+  WriteProgram(writer, main);
+  WriteProgram(writer, cells);
+  writer.Write(cellWidth);
+  writer.Write(cellHeight);
+  writer.Write(static_cast<uint32_t>(textures.size()));
+  for (const auto& texture : textures)
+  {
+    writer.Write(texture.unit);
+    writer.Write(texture.width);
+    writer.Write(texture.height);
+    writer.Write(texture.channels);
+    writer.Write(texture.scaling);
+    writer.Write(texture.repeat);
+    writer.Write(texture.pixels.data(), texture.pixels.size());
+  }
+  output.Close();
+  return true;
+}
+
+bool CFrameCapture::Load(const std::string& file)
+{
+  *this = CFrameCapture();
+
+  kodi::vfs::CFile input;
+  if (!input.OpenFile(file))
+    return false;
+
+  char magic[4];
+  bool ok = input.Read(magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, g_magic, sizeof(magic)) == 0;
+  CReader reader(input);
+  if (ok && reader.Read() == g_version)
+  {
+    renderer = reader.ReadString();
+    version = reader.ReadString();
+    preset = reader.ReadString();
+    width = reader.Read();
+    height = reader.Read();
+    ReadProgram(reader, main);
+    ReadProgram(reader, cells);
+    cellWidth = reader.Read();
+    cellHeight = reader.Read();
+    uint32_t count = reader.Read();
+    for (uint32_t i = 0; i < count && reader.Ok(); i++)
+    {
+      Texture texture;
+      texture.unit = reader.Read();
+      texture.width = reader.Read();
+      texture.height = reader.Read();
+      texture.channels = reader.Read();
+      texture.scaling = reader.Read();
+      texture.repeat = reader.Read();
+      reader.ReadVector(texture.pixels);
+      if ((texture.channels != 1 && texture.channels != 4) ||
+          texture.pixels.size() != static_cast<size_t>(texture.width) * texture.height * texture.channels)
+        ok = false;
+      textures.push_back(std::move(texture));
+    }
+    ok = ok && reader.Ok() && !main.Empty() && width > 0 && height > 0;
+  }
+  else
+  {
+    ok = false;
+  }
+  input.Close();
+
+  if (!ok)
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Frame capture %s is damaged or of another version", file.c_str());
+    *this = CFrameCapture();
+  }
+  return ok;
+}
@@ -0,0 +1,87 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Everything needed to draw one frame of a preset again: the shader sources
+// as they were handed to the compiler, the uniform values read back from the
+// programs and the contents of the bound textures. Written by the capture
+// action, drawn again by CFrameReplay, also on another machine.
+class CFrameCapture
+{
+public:
+  struct Uniform
+  {
+    std::string name;
+    GLenum type;
+    std::vector<float> values; // integers and samplers converted
+  };
+
+  struct Program
+  {
+    std::string vertexBegin;
+    std::string vertex;
+    std::string vertexEnd;
+    std::string fragmentBegin;
+    std::string fragment;
+    std::string fragmentEnd;
+    std::vector<Uniform> uniforms;
+
+    bool Empty() const { return fragment.empty(); }
+    size_t Bytes() const;
+  };
+
+  struct Texture
+  {
+    int unit;
+    int width;
+    int height;
+    int channels; // 4 for RGBA or 1, the local GL format is picked on replay
+    GLint scaling;
+    GLint repeat;
+    std::vector<uint8_t> pixels;
+  };
+
+  std::string renderer;
+  std::string version;
+  std::string preset;
+  int width = 0;
+  int height = 0;
+  Program main;
+  Program cells; // cell pass, empty without one
+  int cellWidth = 0;
+  int cellHeight = 0;
+  std::vector<Texture> textures; // of both passes, the cell pass output is not included
+
+  // Whole file, empty on failure
+  static std::string ReadSource(const std::string& file);
+
+  static void ReadUniforms(GLuint program, std::vector<Uniform>& uniforms);
+  static void ApplyUniforms(GLuint program, const std::vector<Uniform>& uniforms);
+
+  bool Save(const std::string& file) const;
+  bool Load(const std::string& file);
+};
@@ -0,0 +1,249 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FrameReplay.h"
+#include "GPUTimer.h"
+
+#include <kodi/Filesystem.h>
+#include <kodi/General.h>
+
+#include <algorithm>
+#include <cstdio>
+
+// Texture unit the cell pass output is read from, see GatherDefines()
+#define REPLAY_CELL_UNIT (5)
+
+// Single channel textures, GLES 2 has no GL_RED
+#ifdef GL_RED
+#define REPLAY_SINGLE_CHANNEL GL_RED
+#else
+#define REPLAY_SINGLE_CHANNEL GL_LUMINANCE
+#endif
+
+CFrameReplay::CFrameReplay(CGLDeletionQueue& deletionQueue)
+  : m_deletionQueue(deletionQueue),
+    m_main(new kodi::gui::gl::CShaderProgram),
+    m_cells(new kodi::gui::gl::CShaderProgram)
+{
+}
+
+CFrameReplay::~CFrameReplay()
+{
+  for (const auto& texture : m_textures)
+    m_deletionQueue.DeleteTexture(texture.second);
+  m_deletionQueue.DeleteTexture(m_cellTexture);
+  m_deletionQueue.DeleteFramebuffer(m_cellFB);
+}
+
+void CFrameReplay::Forget()
+{
+  // See CVisualizationMatrix::ForgetGLResources()
+  m_main.release();
+  m_cells.release();
+  m_main.reset(new kodi::gui::gl::CShaderProgram);
+  m_cells.reset(new kodi::gui::gl::CShaderProgram);
+  m_textures.clear();
+  m_cellTexture = 0;
+  m_cellFB = 0;
+}
+
+bool CFrameReplay::Compile(const CFrameCapture::Program& program, const std::string& folder, const std::string& name,
+                           kodi::gui::gl::CShaderProgram& shader)
+{
+  // The shader program only loads files, the begin and end parts are added
+  // the same way as when the frame was captured
+  const std::string vertexFile = folder + name + ".vert.glsl";
+  const std::string fragmentFile = folder + name + ".frag.glsl";
+  for (const auto& file : {std::make_pair(vertexFile, &program.vertex), std::make_pair(fragmentFile, &program.fragment)})
+  {
+    kodi::vfs::CFile output;
+    if (!output.OpenFileForWrite(file.first, true))
+      return false;
+    output.Write(file.second->data(), file.second->size());
+    output.Close();
+  }
+
+  if (!shader.LoadShaderFiles(vertexFile, fragmentFile) ||
+      !shader.CompileAndLink(program.vertexBegin, program.vertexEnd, program.fragmentBegin, program.fragmentEnd))
+    return false;
+
+  CFrameCapture::ApplyUniforms(shader.ProgramHandle(), program.uniforms);
+  return true;
+}
+
+bool CFrameReplay::Start(const CFrameCapture& capture, const std::string& folder, GLuint vertexBuffer)
+{
+  if (!kodi::vfs::DirectoryExists(folder))
+    kodi::vfs::CreateDirectory(folder);
+
+  if (!Compile(capture.main, folder, "main", *m_main) ||
+      (!capture.cells.Empty() && !Compile(capture.cells, folder, "cells", *m_cells)))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Frame replay: failed to compile the captured shaders");
+    return false;
+  }
+
+  for (const auto& captured : capture.textures)
+  {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, captured.scaling);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, captured.scaling);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, captured.repeat);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, captured.repeat);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // The capture may come from another GL flavor, its formats are mapped
+    // to the local ones
+    const GLint format = captured.channels == 4 ? GL_RGBA : REPLAY_SINGLE_CHANNEL;
+    glTexImage2D(GL_TEXTURE_2D, 0, format, captured.width, captured.height, 0, format,
+                 GL_UNSIGNED_BYTE, captured.pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    m_textures.push_back(std::make_pair(captured.unit, texture));
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  if (!capture.cells.Empty())
+  {
+    m_cellWidth = capture.cellWidth;
+    m_cellHeight = capture.cellHeight;
+    glGenTextures(1, &m_cellTexture);
+    glBindTexture(GL_TEXTURE_2D, m_cellTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_cellWidth, m_cellHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &m_cellFB);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_cellFB);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_cellTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+  m_header = "Matrix visualization frame replay\n";
+  m_header += "Captured preset: " + capture.preset + "\n";
+  m_header += "Captured on: " + capture.renderer + ", " + capture.version + "\n";
+  m_header += "Replayed on: " + std::string(renderer ? renderer : "unknown") + ", " + std::string(version ? version : "unknown") + "\n";
+  m_header += "Resolution: " + std::to_string(capture.width) + "x" + std::to_string(capture.height) + "\n";
+  if (!capture.cells.Empty())
+    m_header += "Cell pass: " + std::to_string(m_cellWidth) + "x" + std::to_string(m_cellHeight) + "\n";
+
+  m_vertexBuffer = vertexBuffer;
+  m_width = capture.width;
+  m_height = capture.height;
+  m_frames = 0;
+  m_cpuTime = 0.0;
+  m_gpuTimes.clear();
+  m_start = std::chrono::high_resolution_clock::now();
+  kodi::Log(ADDON_LOG_INFO, "Frame replay of %s started", capture.preset.c_str());
+  return true;
+}
+
+void CFrameReplay::Draw(GLuint program)
+{
+  GLint vertex = glGetAttribLocation(program, "vertex");
+  glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+  glVertexAttribPointer(vertex, 4, GL_FLOAT, 0, 16, 0);
+  glEnableVertexAttribArray(vertex);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+  glDisableVertexAttribArray(vertex);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CFrameReplay::Render()
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLint framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+  CGPUTimer timer;
+  auto start = std::chrono::high_resolution_clock::now();
+  timer.Begin();
+
+  for (const auto& texture : m_textures)
+  {
+    glActiveTexture(GL_TEXTURE0 + texture.first);
+    glBindTexture(GL_TEXTURE_2D, texture.second);
+  }
+
+  if (m_cellFB)
+  {
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_BLEND);
+    glUseProgram(m_cells->ProgramHandle());
+    glBindFramebuffer(GL_FRAMEBUFFER, m_cellFB);
+    glViewport(0, 0, m_cellWidth, m_cellHeight);
+    Draw(m_cells->ProgramHandle());
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (blend)
+      glEnable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0 + REPLAY_CELL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_cellTexture);
+  }
+
+  // The resolution is baked into the shader, so the frame keeps its size
+  glUseProgram(m_main->ProgramHandle());
+  glViewport(viewport[0], viewport[1], m_width, m_height);
+  Draw(m_main->ProgramHandle());
+  glUseProgram(0);
+
+  auto submitted = std::chrono::high_resolution_clock::now();
+  m_gpuTimes.push_back(timer.End());
+  m_cpuTime += std::chrono::duration<double, std::milli>(submitted - start).count();
+  m_frames++;
+
+  for (int i = 0; i <= REPLAY_CELL_UNIT; i++)
+  {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+double CFrameReplay::Seconds() const
+{
+  return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_start).count();
+}
+
+std::string CFrameReplay::Report() const
+{
+  std::string report = m_header;
+  report += "\nframes;cpu ms;gpu ms;gpu 95% ms;gpu max ms\n";
+  if (!m_frames)
+    return report;
+
+  std::vector<double> times = m_gpuTimes;
+  std::sort(times.begin(), times.end());
+  double sum = 0.0;
+  for (double time : times)
+    sum += time;
+
+  char line[128];
+  snprintf(line, sizeof(line), "%i;%.3f;%.3f;%.3f;%.3f\n", m_frames, m_cpuTime / m_frames, sum / m_frames,
+           times[times.size() * 95 / 100], times.back());
+  return report + line;
+}
@@ -0,0 +1,77 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "FrameCapture.h"
+#include "GLDeletionQueue.h"
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Draws a captured frame over and over, each one timed like a benchmark
+// frame. Meant to run a reported slow frame under timers and GPU profilers
+// on a development machine.
+class CFrameReplay
+{
+public:
+  explicit CFrameReplay(CGLDeletionQueue& deletionQueue);
+  ~CFrameReplay();
+
+  // Compiles the captured programs, their sources are written to folder
+  bool Start(const CFrameCapture& capture, const std::string& folder, GLuint vertexBuffer);
+
+  // Draws the frame once into the current framebuffer
+  void Render();
+
+  double Seconds() const;
+  std::string Report() const;
+
+  // Drops the GL objects without deleting, for a lost context
+  void Forget();
+
+private:
+  bool Compile(const CFrameCapture::Program& program, const std::string& folder, const std::string& name,
+               kodi::gui::gl::CShaderProgram& shader);
+  void Draw(GLuint program);
+
+  CGLDeletionQueue& m_deletionQueue;
+  std::unique_ptr<kodi::gui::gl::CShaderProgram> m_main;
+  std::unique_ptr<kodi::gui::gl::CShaderProgram> m_cells;
+  std::vector<std::pair<int, GLuint>> m_textures; // unit and texture
+  GLuint m_cellTexture = 0;
+  GLuint m_cellFB = 0;
+  GLuint m_vertexBuffer = 0;
+
+  std::string m_header;
+  int m_width = 0;
+  int m_height = 0;
+  int m_cellWidth = 0;
+  int m_cellHeight = 0;
+
+  int m_frames = 0;
+  double m_cpuTime = 0.0;
+  std::vector<double> m_gpuTimes;
+  std::chrono::high_resolution_clock::time_point m_start;
+};
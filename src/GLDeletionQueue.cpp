@@ -0,0 +1,151 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GLDeletionQueue.h"
+
+// Frames an object is kept at least after its release
+#define DELETION_DELAY (3)
+// Maximum number of objects deleted per frame to spread the driver work
+#define DELETION_BATCH (4)
+
+CGLDeletionQueue::~CGLDeletionQueue()
+{
+  Flush();
+}
+
+void CGLDeletionQueue::DeleteTexture(GLuint texture)
+{
+  Release(OBJECT_TEXTURE, texture);
+}
+
+void CGLDeletionQueue::DeleteFramebuffer(GLuint framebuffer)
+{
+  Release(OBJECT_FRAMEBUFFER, framebuffer);
+}
+
+void CGLDeletionQueue::DeleteBuffer(GLuint buffer)
+{
+  Release(OBJECT_BUFFER, buffer);
+}
+
+void CGLDeletionQueue::Release(ObjectType type, GLuint name)
+{
+  if (name)
+    m_released.push_back({type, name});
+}
+
+void CGLDeletionQueue::EndFrame()
+{
+  if (!m_released.empty())
+  {
+    Batch batch;
+    batch.frame = m_frame;
+#if defined(HAS_GL_SYNC)
+    batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+    batch.objects.swap(m_released);
+    m_batches.push_back(std::move(batch));
+  }
+
+  int budget = DELETION_BATCH;
+  while (budget > 0 && !m_batches.empty())
+  {
+    Batch& batch = m_batches.front();
+    if (m_frame - batch.frame < DELETION_DELAY)
+      break;
+
+#if defined(HAS_GL_SYNC)
+    if (batch.fence)
+    {
+      // Never block here, try again next frame
+      GLenum result = glClientWaitSync(batch.fence, 0, 0);
+      if (result == GL_TIMEOUT_EXPIRED)
+        break;
+      glDeleteSync(batch.fence);
+      batch.fence = 0;
+    }
+#endif
+
+    while (budget > 0 && !batch.objects.empty())
+    {
+      Delete(batch.objects.back());
+      batch.objects.pop_back();
+      budget--;
+    }
+
+    if (batch.objects.empty())
+      m_batches.pop_front();
+  }
+
+  m_frame++;
+}
+
+void CGLDeletionQueue::Flush()
+{
+  for (auto& batch : m_batches)
+    FreeBatch(batch);
+  m_batches.clear();
+
+  for (const auto& object : m_released)
+    Delete(object);
+  m_released.clear();
+}
+
+void CGLDeletionQueue::Forget()
+{
+  m_batches.clear();
+  m_released.clear();
+}
+
+size_t CGLDeletionQueue::Pending() const
+{
+  size_t pending = m_released.size();
+  for (const auto& batch : m_batches)
+    pending += batch.objects.size();
+  return pending;
+}
+
+void CGLDeletionQueue::FreeBatch(Batch& batch)
+{
+#if defined(HAS_GL_SYNC)
+  if (batch.fence)
+    glDeleteSync(batch.fence);
+  batch.fence = 0;
+#endif
+  for (const auto& object : batch.objects)
+    Delete(object);
+  batch.objects.clear();
+}
+
+void CGLDeletionQueue::Delete(const Object& object)
+{
+  switch (object.type)
+  {
+    case OBJECT_TEXTURE:
+      glDeleteTextures(1, &object.name);
+      break;
+    case OBJECT_FRAMEBUFFER:
+      glDeleteFramebuffers(1, &object.name);
+      break;
+    case OBJECT_BUFFER:
+      glDeleteBuffers(1, &object.name);
+      break;
+  }
+}
@@ -0,0 +1,86 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <deque>
+#include <vector>
+
+// Fence sync objects are core in desktop GL 3.2 and GLES 3.0
+#if defined(HAS_GL) || (defined(HAS_GLES) && HAS_GLES >= 3)
+#define HAS_GL_SYNC
+#endif
+
+// Defers the deletion of GL objects until the GPU is done with them. Some
+// drivers stall the render thread when an object still in use is deleted.
+// Released objects are tagged with the frame that released them and freed
+// a few frames later, in small batches, once that frame's fence signaled.
+class CGLDeletionQueue
+{
+public:
+  ~CGLDeletionQueue();
+
+  void DeleteTexture(GLuint texture);
+  void DeleteFramebuffer(GLuint framebuffer);
+  void DeleteBuffer(GLuint buffer);
+
+  // Called once per frame after the last draw call
+  void EndFrame();
+
+  // Deletes all pending objects right away, the context must be current
+  void Flush();
+  // Drops all pending objects without deleting, for a lost context
+  void Forget();
+
+  size_t Pending() const;
+
+private:
+  enum ObjectType
+  {
+    OBJECT_TEXTURE,
+    OBJECT_FRAMEBUFFER,
+    OBJECT_BUFFER,
+  };
+
+  struct Object
+  {
+    ObjectType type;
+    GLuint name;
+  };
+
+  struct Batch
+  {
+    unsigned int frame;
+#if defined(HAS_GL_SYNC)
+    GLsync fence;
+#endif
+    std::vector<Object> objects;
+  };
+
+  void Release(ObjectType type, GLuint name);
+  static void Delete(const Object& object);
+  void FreeBatch(Batch& batch);
+
+  unsigned int m_frame = 0;
+  std::vector<Object> m_released; // released during the current frame
+  std::deque<Batch> m_batches;     // waiting for their fence, oldest first
+};
@@ -0,0 +1,58 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GPUTimer.h"
+
+CGPUTimer::CGPUTimer()
+{
+#if defined(HAS_GL)
+  glGenQueries(1, &m_query);
+#endif
+}
+
+CGPUTimer::~CGPUTimer()
+{
+#if defined(HAS_GL)
+  glDeleteQueries(1, &m_query);
+#endif
+}
+
+void CGPUTimer::Begin()
+{
+#if defined(HAS_GL)
+  glBeginQuery(GL_TIME_ELAPSED, m_query);
+#else
+  glFinish();
+  m_start = std::chrono::high_resolution_clock::now();
+#endif
+}
+
+double CGPUTimer::End()
+{
+#if defined(HAS_GL)
+  glEndQuery(GL_TIME_ELAPSED);
+  GLuint64 ns = 0;
+  glGetQueryObjectui64v(m_query, GL_QUERY_RESULT, &ns);
+  return ns / 1000000.0;
+#else
+  glFinish();
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+#endif
+}
@@ -0,0 +1,47 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <chrono>
+
+// Measures the GPU time of the commands between Begin() and End(). Desktop
+// GL uses a GL_TIME_ELAPSED query, GLES has no timer queries in core, there
+// the whole pipeline is drained with glFinish() and the wall time is taken.
+// Both ways block until the GPU is done, only use it for measurements.
+class CGPUTimer
+{
+public:
+  CGPUTimer();
+  ~CGPUTimer();
+
+  void Begin();
+  // Returns the elapsed time in milliseconds
+  double End();
+
+private:
+#if defined(HAS_GL)
+  GLuint m_query = 0;
+#else
+  std::chrono::high_resolution_clock::time_point m_start;
+#endif
+};
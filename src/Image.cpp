@@ -0,0 +1,249 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Image.h"
+
+#include "stb_image.h"
+#include <kodi/General.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Squared euclidean distance transform of one row or column in place, see
+// Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions".
+// Far is finite to keep the intersections of the parabolas defined.
+const float g_far = 1e20f;
+
+void DistanceTransform(float* f, int n, int stride, std::vector<float>& d, std::vector<int>& v, std::vector<float>& z)
+{
+  auto intersection = [&](int q, int p)
+  {
+    return ((f[q * stride] + q * q) - (f[p * stride] + p * p)) / (2.0f * (q - p));
+  };
+
+  int k = 0;
+  v[0] = 0;
+  z[0] = -HUGE_VALF;
+  z[1] = HUGE_VALF;
+  for (int q = 1; q < n; q++)
+  {
+    float s = intersection(q, v[k]);
+    while (s <= z[k])
+    {
+      k--;
+      s = intersection(q, v[k]);
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = HUGE_VALF;
+  }
+
+  k = 0;
+  for (int q = 0; q < n; q++)
+  {
+    while (z[k + 1] < q)
+      k++;
+    const int p = v[k];
+    d[q] = (q - p) * (q - p) + f[p * stride];
+  }
+  for (int q = 0; q < n; q++)
+    f[q * stride] = d[q];
+}
+
+// Squared distance of every pixel to the nearest pixel of the other kind
+std::vector<float> DistanceTransform(const std::vector<bool>& inside, bool to, int width, int height)
+{
+  std::vector<float> grid(inside.size());
+  for (size_t i = 0; i < inside.size(); i++)
+    grid[i] = inside[i] == to ? 0.0f : g_far;
+
+  const int size = std::max(width, height);
+  std::vector<float> d(size);
+  std::vector<int> v(size);
+  std::vector<float> z(size + 1);
+  for (int x = 0; x < width; x++)
+    DistanceTransform(grid.data() + x, height, width, d, v, z);
+  for (int y = 0; y < height; y++)
+    DistanceTransform(grid.data() + y * width, width, 1, d, v, z);
+  return grid;
+}
+
+} // namespace
+
+bool CImage::Load(const std::string& file)
+{
+  int n;
+  // Per thread, images are also decoded on the thread pool
+  stbi_set_flip_vertically_on_load_thread(true);
+  unsigned char* image = stbi_load(file.c_str(), &m_width, &m_height, &n, STBI_rgb_alpha);
+  if (image == nullptr)
+  {
+    kodi::Log(ADDON_LOG_ERROR, "couldn't load image %s", file.c_str());
+    m_width = m_height = 0;
+    m_pixels.clear();
+    return false;
+  }
+
+  m_pixels.assign(image, image + m_width * m_height * 4);
+  stbi_image_free(image);
+  return true;
+}
+
+CImage CImage::Downscale(int factor) const
+{
+  CImage result;
+  if (m_pixels.empty())
+    return result;
+
+  // Odd sizes keep their last row and column, down to 1x1 for mip chains
+  result.m_width = std::max(m_width / factor, 1);
+  result.m_height = std::max(m_height / factor, 1);
+  result.m_pixels.resize(result.m_width * result.m_height * 4);
+
+  const int area = factor * factor;
+  for (int y = 0; y < result.m_height; y++)
+  {
+    for (int x = 0; x < result.m_width; x++)
+    {
+      unsigned int sum[4] = {0, 0, 0, 0};
+      for (int by = 0; by < factor; by++)
+      {
+        const int sy = std::min(y * factor + by, m_height - 1);
+        for (int bx = 0; bx < factor; bx++)
+        {
+          const int sx = std::min(x * factor + bx, m_width - 1);
+          const unsigned char* source = m_pixels.data() + (sy * m_width + sx) * 4;
+          for (int c = 0; c < 4; c++)
+            sum[c] += source[c];
+        }
+      }
+      unsigned char* pixel = result.m_pixels.data() + (y * result.m_width + x) * 4;
+      for (int c = 0; c < 4; c++)
+        pixel[c] = static_cast<unsigned char>((sum[c] + area / 2) / area);
+    }
+  }
+  return result;
+}
+
+CImage CImage::DistanceField(int size, float spread) const
+{
+  CImage result;
+  if (m_pixels.empty())
+    return result;
+
+  std::vector<bool> inside(m_width * m_height);
+  for (size_t i = 0; i < inside.size(); i++)
+    inside[i] = m_pixels[i * 4] >= 128;
+
+  // The edge is half way between the pixels on either side of it
+  const std::vector<float> outsideDistance = DistanceTransform(inside, true, m_width, m_height);
+  const std::vector<float> insideDistance = DistanceTransform(inside, false, m_width, m_height);
+  std::vector<float> distance(inside.size());
+  for (size_t i = 0; i < inside.size(); i++)
+    distance[i] = inside[i] ? 0.5f - std::sqrt(insideDistance[i]) : std::sqrt(outsideDistance[i]) - 0.5f;
+
+  // Bilinear samples at the texel centers, like the GPU reads them back
+  result.m_width = size;
+  result.m_height = size;
+  result.m_pixels.resize(size * size * 4);
+  auto at = [&](int x, int y)
+  {
+    x = std::min(std::max(x, 0), m_width - 1);
+    y = std::min(std::max(y, 0), m_height - 1);
+    return distance[y * m_width + x];
+  };
+  for (int y = 0; y < size; y++)
+  {
+    const float sy = (y + 0.5f) * m_height / size - 0.5f;
+    const int y0 = static_cast<int>(std::floor(sy));
+    const float fy = sy - y0;
+    for (int x = 0; x < size; x++)
+    {
+      const float sx = (x + 0.5f) * m_width / size - 0.5f;
+      const int x0 = static_cast<int>(std::floor(sx));
+      const float fx = sx - x0;
+      const float bottom = at(x0, y0) + (at(x0 + 1, y0) - at(x0, y0)) * fx;
+      const float top = at(x0, y0 + 1) + (at(x0 + 1, y0 + 1) - at(x0, y0 + 1)) * fx;
+      const float value = 0.5f - (bottom + (top - bottom) * fy) / m_width / (2.0f * spread);
+      const unsigned char encoded = static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+      unsigned char* pixel = result.m_pixels.data() + (y * size + x) * 4;
+      pixel[0] = pixel[1] = pixel[2] = encoded;
+      pixel[3] = 255;
+    }
+  }
+  return result;
+}
+
+std::vector<unsigned char> CImage::Channel(int channel) const
+{
+  std::vector<unsigned char> result(m_pixels.size() / 4);
+  for (size_t i = 0; i < result.size(); i++)
+    result[i] = m_pixels[i * 4 + channel];
+  return result;
+}
+
+float CImage::Sample(float u, float v, int channel, bool repeat) const
+{
+  if (m_pixels.empty())
+    return 0.0f;
+
+  // Keeps large coordinates (e.g. scrolling noise) in integer range
+  if (repeat)
+  {
+    u -= std::floor(u);
+    v -= std::floor(v);
+  }
+
+  float x = u * m_width - 0.5f;
+  float y = v * m_height - 0.5f;
+  float x0 = std::floor(x);
+  float y0 = std::floor(y);
+  float fx = x - x0;
+  float fy = y - y0;
+
+  auto texel = [&](int tx, int ty)
+  {
+    if (repeat)
+    {
+      tx %= m_width;
+      ty %= m_height;
+      if (tx < 0)
+        tx += m_width;
+      if (ty < 0)
+        ty += m_height;
+    }
+    else
+    {
+      tx = tx < 0 ? 0 : (tx >= m_width ? m_width - 1 : tx);
+      ty = ty < 0 ? 0 : (ty >= m_height ? m_height - 1 : ty);
+    }
+    return m_pixels[(ty * m_width + tx) * 4 + channel] / 255.0f;
+  };
+
+  int ix = static_cast<int>(x0);
+  int iy = static_cast<int>(y0);
+  float bottom = texel(ix, iy) + (texel(ix + 1, iy) - texel(ix, iy)) * fx;
+  float top = texel(ix, iy + 1) + (texel(ix + 1, iy + 1) - texel(ix, iy + 1)) * fx;
+  return bottom + (top - bottom) * fy;
+}
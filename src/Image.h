@@ -0,0 +1,56 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Decoded RGBA image, bottom row first like the textures made from it
+class CImage
+{
+public:
+  bool Load(const std::string& file);
+
+  // Averages factor x factor blocks, at least 1x1
+  CImage Downscale(int factor) const;
+
+  // Signed distance field of the shape where the first channel is above
+  // half, size x size texels of .5 - distance/(2*spread) in all channels.
+  // The distance is in image widths and positive outside the shape.
+  CImage DistanceField(int size, float spread) const;
+
+  bool Empty() const { return m_pixels.empty(); }
+  int Width() const { return m_width; }
+  int Height() const { return m_height; }
+  const unsigned char* Data() const { return m_pixels.data(); }
+
+  // One channel of all pixels, e.g. for an R8 texture
+  std::vector<unsigned char> Channel(int channel) const;
+
+  // Bilinear sample of one channel in 0..1, like GL_LINEAR with either
+  // GL_REPEAT or GL_CLAMP_TO_EDGE
+  float Sample(float u, float v, int channel, bool repeat) const;
+
+private:
+  int m_width = 0;
+  int m_height = 0;
+  std::vector<unsigned char> m_pixels;
+};
@@ -0,0 +1,72 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MemoryBudget.h"
+
+#include <cstdint>
+#include <cstdio>
+
+namespace
+{
+
+const char* g_names[CMemoryBudget::CATEGORIES] = {"analysis", "textures", "albums", "framebuffers", "shaders"};
+
+// Percent of the budget per category. The covers and the framebuffers
+// scale with the screen and the music, the rest is nearly fixed.
+const unsigned int g_shares[CMemoryBudget::CATEGORIES] = {5, 20, 40, 30, 5};
+
+} // namespace
+
+size_t CMemoryBudget::Share(Category category) const
+{
+  if (!m_budget)
+    return SIZE_MAX;
+  return m_budget / 100 * g_shares[category];
+}
+
+size_t CMemoryBudget::Used() const
+{
+  size_t used = 0;
+  for (size_t bytes : m_used)
+    used += bytes;
+  return used;
+}
+
+std::string CMemoryBudget::ToString() const
+{
+  std::string result;
+  char buffer[96];
+  for (int i = 0; i < CATEGORIES; i++)
+  {
+    Category category = static_cast<Category>(i);
+    if (m_budget)
+      snprintf(buffer, sizeof(buffer), "%s %zu/%zu KiB%s, ", g_names[i], Used(category) / 1024, Share(category) / 1024,
+               Fits(category, Used(category)) ? "" : " (over)");
+    else
+      snprintf(buffer, sizeof(buffer), "%s %zu KiB, ", g_names[i], Used(category) / 1024);
+    result += buffer;
+  }
+
+  if (m_budget)
+    snprintf(buffer, sizeof(buffer), "total %zu of %zu KiB", Used() / 1024, m_budget / 1024);
+  else
+    snprintf(buffer, sizeof(buffer), "total %zu KiB, no budget", Used() / 1024);
+  return result + buffer;
+}
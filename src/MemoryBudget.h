@@ -0,0 +1,61 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Splits a memory budget into fixed shares per allocation category. The
+// owners report what they use and ask before growing, each one degrades on
+// its own when its share is exhausted. GPU memory is estimated from the
+// texture sizes, drivers add their own overhead on top.
+class CMemoryBudget
+{
+public:
+  enum Category
+  {
+    ANALYSIS,     // audio buffers and FFT scratch
+    TEXTURES,     // preset textures and their CPU copies
+    ALBUMS,       // album covers, cached and being uploaded
+    FRAMEBUFFERS, // effect and cell framebuffers, CPU cell buffers
+    SHADERS,      // shader sources kept for the compiled programs
+    CATEGORIES
+  };
+
+  // 0 disables the budget
+  void SetBudget(size_t bytes) { m_budget = bytes; }
+  size_t Budget() const { return m_budget; }
+  bool Limited() const { return m_budget != 0; }
+
+  // Bytes the category may use, SIZE_MAX without a budget
+  size_t Share(Category category) const;
+  bool Fits(Category category, size_t bytes) const { return bytes <= Share(category); }
+
+  void SetUsed(Category category, size_t bytes) { m_used[category] = bytes; }
+  size_t Used(Category category) const { return m_used[category]; }
+  size_t Used() const;
+
+  std::string ToString() const;
+
+private:
+  size_t m_budget = 0;
+  size_t m_used[CATEGORIES] = {};
+};
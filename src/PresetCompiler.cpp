@@ -0,0 +1,422 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "PresetCompiler.h"
+
+#include <kodi/Filesystem.h>
+#include <kodi/General.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace
+{
+
+// Stage types in the order they may appear in a preset
+const std::vector<std::string> g_stageTypes =
+{
+  "rain", "distortion", "logo", "album", "fft", "waveform", "envelope", "noise", "vignette", "output",
+};
+
+// Shading of the album stage, its shadow needs a dark surrounding
+const char* g_albumShading =
+R"stage(  tex *= .9 - wav*.2;
+  float shadow = (wav+.5)*.25;
+  tex = (max(shadow,tex)-shadow)/(1.-shadow);
+)stage";
+
+// Distortion lines shared by the logo and the album stage
+const char* g_imageLines =
+R"stage(  tex *= 1. - (mod(gv.y*sign(wav),2.)*10.*distort_abs + 5.*distort_abs);
+)stage";
+
+} // namespace
+
+bool CPresetCompiler::Load(const std::string& file)
+{
+  m_file = file;
+
+  kodi::vfs::CFile input;
+  if (!input.OpenFile(file))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to open preset '%s'", file.c_str());
+    return false;
+  }
+
+  std::string source;
+  std::string line;
+  while (input.ReadLine(line))
+    source += line + "\n";
+  input.Close();
+
+  return Parse(source);
+}
+
+bool CPresetCompiler::Parse(const std::string& source)
+{
+  m_stages.clear();
+
+  std::istringstream lines(source);
+  std::string line;
+  size_t order = 0;
+  while (std::getline(lines, line))
+  {
+    line = line.substr(0, line.find('#'));
+
+    std::istringstream words(line);
+    Stage stage;
+    if (!(words >> stage.type))
+      continue;
+
+    std::string param;
+    while (words >> param)
+    {
+      size_t pos = param.find('=');
+      if (pos == std::string::npos)
+      {
+        kodi::Log(ADDON_LOG_ERROR, "Preset '%s': parameter '%s' of stage %s has no value", m_file.c_str(), param.c_str(), stage.type.c_str());
+        return false;
+      }
+      stage.params[param.substr(0, pos)] = param.substr(pos + 1);
+    }
+
+    // Stages are applied in a fixed order, so their effect on the intensity
+    // is the same in every preset
+    size_t type = 0;
+    while (type < g_stageTypes.size() && g_stageTypes[type] != stage.type)
+      type++;
+    if (type == g_stageTypes.size())
+    {
+      kodi::Log(ADDON_LOG_ERROR, "Preset '%s': unknown stage %s", m_file.c_str(), stage.type.c_str());
+      return false;
+    }
+    if (type < order || (type == order && !m_stages.empty() && m_stages.back().type == stage.type))
+    {
+      kodi::Log(ADDON_LOG_ERROR, "Preset '%s': stage %s is out of order or repeated", m_file.c_str(), stage.type.c_str());
+      return false;
+    }
+    order = type;
+
+    m_stages.push_back(stage);
+  }
+
+  if (!Has("rain"))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Preset '%s': a rain stage is required", m_file.c_str());
+    return false;
+  }
+  if (Has("logo") && Has("album"))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Preset '%s': logo and album can't be combined", m_file.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+CPresetCompiler::Result CPresetCompiler::Compile(const Options& options) const
+{
+  Result result;
+
+  // Stages reading the distortion keep it alive, otherwise it is dead
+  bool distorted = false;
+  for (const auto& stage : m_stages)
+  {
+    if (stage.type == "logo" || stage.type == "album" ||
+        (stage.type == "fft" && Param(stage, "coord", "plain") == "distorted"))
+      distorted = true;
+  }
+  if ((Has("logo") || Has("album")) && !Has("distortion"))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Preset '%s': logo and album need the distortion stage", m_file.c_str());
+    return result;
+  }
+
+  for (const auto& stage : m_stages)
+  {
+    if (stage.type == "rain")
+      result.rainBase = static_cast<float>(Param(stage, "base", 1.0));
+    else if (stage.type == "vignette")
+      result.vignette = static_cast<float>(Param(stage, "intensity", 0.05));
+  }
+
+  if (options.hybrid)
+  {
+    // Everything but the dot shape comes from the cells
+    result.cellProgram = CompileCells();
+    result.fragment = "void main(void)\n{\n  vec2 uv = FRAG_UV;\n  vec2 gv = floor(uv*cColumns);\n";
+    result.fragment += "  float bw = texture(iCells, CELL_COORD(gv)).r;\n";
+    result.fragment += "  bw *= bw*" + Literal(CELL_INTENSITY_RANGE) + ";\n";
+    result.fragment += "\n  //pseudo pixels (dots)\n";
+    result.fragment += "  vec3 col = bw2col(bw,uv);\n";
+    result.fragment += "  FragColor = vec4(col,1.0);\n}\n";
+    result.ok = true;
+    return result;
+  }
+
+  // Values depending only on gv and time, computed once per cell if the
+  // cell pass is used. The low power noise is sampled per pixel.
+  std::string cellValues;
+  std::string cellChannels[2];
+  const bool cellNoise = Has("noise") && !options.lowpower;
+
+  std::string body;
+  for (const auto& stage : m_stages)
+  {
+    const std::string& type = stage.type;
+    if (type == "rain")
+    {
+      cellValues += "  float rainPhase = fract((gv.y*.0024)+iTime*(h11(gv.x) + 0.1));\n";
+      cellChannels[0] = "rainPhase";
+      body += "  float rain = " + Literal(Param(stage, "base", 1.0)) + " - rainPhase;\n";
+      body += "  float bw = rain;\n";
+    }
+    else if (type == "distortion")
+    {
+      if (!distorted)
+      {
+        kodi::Log(ADDON_LOG_DEBUG, "Preset '%s': distortion is unused, removed", m_file.c_str());
+        continue;
+      }
+      body += "\n  //VHS-like distortions\n";
+      body += "  float wav = texture(iChannel0, DISTORT_COORD(uv)).x-.5;\n";
+      body += "  float distort = sign(wav)*max(abs(wav)-cDistortThreshold,.0);\n";
+      body += "  float distort_abs = abs(distort);\n";
+    }
+    else if (type == "logo")
+    {
+      // The shadow and the outline are shaded from the distance, the
+      // shadow shrinks while the waveform rises
+      const std::string edge = Literal(LOGO_EDGE);
+      const double shadow = Param(stage, "shadow", 0.18);
+      const double outline = Param(stage, "outline", 0.0);
+      body += "\n  //logo\n";
+      body += "  float dist = (.5-texture(iChannel1, LOGO_COORD(uv)-distort*vec2(DISTORTFACTORX,DISTORTFACTORY)).x)*" + Literal(2.0 * LOGO_SDF_SPREAD) + ";\n";
+      body += "  float tex = (1.-smoothstep(-" + edge + "," + edge + ",dist))*(.9-wav*.2);\n";
+      if (shadow > 0.0)
+        body += "  tex = max(tex," + Literal(shadow) + "*(1.-2.*wav)*(1.-smoothstep(0.," + Literal(LOGO_SHADOW_WIDTH) + ",dist)));\n";
+      if (outline > 0.0)
+        body += "  tex = max(tex,(1.-smoothstep(-" + edge + "," + edge + ",abs(dist-" + Literal(1.5 * outline) + ")-" + Literal(0.5 * outline) + "))*(.9-wav*.2));\n";
+      body += g_imageLines;
+      body += "  bw *= tex*.7 + .1;\n";
+      body += "  bw += distort_abs*.2;\n";
+    }
+    else if (type == "album")
+    {
+      body += "\n  //album\n";
+      body += "  vec2 albumcoords = ALBUM_COORD(uv)-distort*vec2(DISTORTFACTORX,DISTORTFACTORY);\n";
+      body += "  vec3 album = texture(iChannel3, albumcoords).rgb;\n";
+      body += "  //thanks GLES 2.0 for not having clamping to border\n";
+      body += "  album *= step(0.,albumcoords).x - step(1.,albumcoords).x;\n";
+      body += "  album *= step(0.,albumcoords).y - step(1.,albumcoords).y;\n";
+      body += "  float tex = dot(album,iAlbumRGB);\n";
+      body += g_albumShading;
+      body += g_imageLines;
+      body += "  bw = bw*max(tex,MININTENSITY);\n";
+      body += "  bw += min(distort_abs*.7,.0105);\n";
+    }
+    else if (type == "fft")
+    {
+      body += "\n  //FFT\n";
+      if (Param(stage, "coord", "plain") == "distorted")
+        body += "  float fft = texture(iChannel0, vec2((1.-abs(uv.x-distort*.2))*.7,0.0)).x;\n";
+      else
+        body += "  float fft = texture(iChannel0, FFT_COORD(uv)).x;\n";
+
+      if (Param(stage, "shape", "falloff") == "boost")
+      {
+        // (3.2 - abs(uv.x*1.3)) * 0.75 * 1.8
+        const double gain = 0.75 * 1.8;
+        body += "  fft *= " + Literal(3.2 * gain) + " - abs(uv.x)*" + Literal(1.3 * gain) + ";\n";
+      }
+      else
+      {
+        body += "  fft -= abs(uv.x)*.25;\n";
+      }
+
+      body += "  bw *= 1. + fft*0.4;\n";
+      body += "  bw += bw*clamp((pow(fft*1.3,2.)-12.),.0,.6);\n";
+      body += "  bw += bw*clamp((pow(fft,3.)-23.),.0,.7);\n";
+
+      double limit = Param(stage, "limit", 0.0);
+      if (limit > 0.0)
+        body += "  bw = min(bw," + Literal(limit) + ");\n";
+    }
+    else if (type == "waveform")
+    {
+      body += "\n  //waveform\n";
+      body += "  bw -= waveform(uv);\n";
+    }
+    else if (type == "envelope")
+    {
+      // abs(uv.y*wave*.5)*100.
+      body += "\n  //waveform envelope\n";
+      body += "  bw -= min(" + Literal(Param(stage, "limit", 0.8)) + ",abs(uv.y*texture(iChannel0,ENVELOPE_COORD(uv)).x)*50.);\n";
+    }
+    else if (type == "noise")
+    {
+      if (cellNoise)
+      {
+        cellValues += "  float noiseValue = noise(gv);\n";
+        cellChannels[1] = "noiseValue";
+        body += "\n  //noise texture\n";
+        body += "  bw *= noiseValue;\n";
+      }
+      else
+      {
+        body += "\n  //noise texture\n";
+        body += "  bw *= noise(gv);\n";
+      }
+    }
+    else if (type == "vignette")
+    {
+      double intensity = Param(stage, "intensity", 0.05);
+      if (intensity == 0.0)
+        continue;
+      body += "\n  //vignette effect\n";
+      body += "  bw -= length(uv)*" + Literal(intensity) + ";\n";
+    }
+  }
+
+  // The output stage is implicit if not given
+  double intensity = 1.0;
+  for (const auto& stage : m_stages)
+  {
+    if (stage.type == "output")
+      intensity = Param(stage, "intensity", 1.0);
+  }
+  body += "\n  //pseudo pixels (dots)\n";
+  body += "  vec3 col = bw2col(bw,uv);\n";
+  if (intensity != 1.0)
+    body += "  col *= " + Literal(intensity) + ";\n";
+  body += "  FragColor = vec4(col,1.0);\n";
+
+  std::string header = "void main(void)\n{\n  vec2 uv = FRAG_UV;\n  vec2 gv = floor(uv*cColumns);\n";
+  if (options.cellPass)
+  {
+    const std::string steps = Literal(CELL_PHASE_STEPS);
+
+    result.cellFragment = "void main(void)\n{\n  vec2 gv = floor(gl_FragCoord.xy) + cCellOffset;\n";
+    result.cellFragment += cellValues;
+    result.cellFragment += "  float phaseSteps = " + cellChannels[0] + "*" + steps + ";\n";
+    result.cellFragment += "  FragColor = vec4(floor(phaseSteps)/" + steps + "," +
+                           (cellChannels[1].empty() ? "0." : cellChannels[1]) + ",fract(phaseSteps),1.);\n}\n";
+
+    header += "  vec4 cell = texture(iCells, CELL_COORD(gv));\n";
+    header += "  float rainPhase = cell.r + cell.b/" + steps + ";\n";
+    if (!cellChannels[1].empty())
+      header += "  float noiseValue = cell.g;\n";
+  }
+  else
+  {
+    header += cellValues;
+  }
+
+  result.fragment = header + "\n" + body + "}\n";
+  result.ok = true;
+  return result;
+}
+
+CPresetCompiler::CellProgram CPresetCompiler::CompileCells() const
+{
+  CellProgram program;
+  for (const auto& stage : m_stages)
+  {
+    const std::string& type = stage.type;
+    if (type == "rain")
+    {
+      program.rainBase = static_cast<float>(Param(stage, "base", 1.0));
+    }
+    else if (type == "logo")
+    {
+      program.image = IMAGE_LOGO;
+      program.logoShadow = static_cast<float>(Param(stage, "shadow", 0.18));
+      program.logoOutline = static_cast<float>(Param(stage, "outline", 0.0));
+    }
+    else if (type == "album")
+    {
+      program.image = IMAGE_ALBUM;
+    }
+    else if (type == "fft")
+    {
+      program.fft = true;
+      program.fftDistorted = Param(stage, "coord", "plain") == "distorted";
+      program.fftBoost = Param(stage, "shape", "falloff") == "boost";
+      program.fftLimit = static_cast<float>(Param(stage, "limit", 0.0));
+    }
+    else if (type == "waveform")
+    {
+      program.waveform = true;
+    }
+    else if (type == "envelope")
+    {
+      program.envelopeLimit = static_cast<float>(Param(stage, "limit", 0.8));
+    }
+    else if (type == "noise")
+    {
+      program.noise = true;
+    }
+    else if (type == "vignette")
+    {
+      program.vignette = static_cast<float>(Param(stage, "intensity", 0.05));
+    }
+    else if (type == "output")
+    {
+      // bw2col is linear in the intensity
+      program.intensity = static_cast<float>(Param(stage, "intensity", 1.0));
+    }
+  }
+  program.distortion = program.image != IMAGE_NONE || (program.fft && program.fftDistorted);
+  return program;
+}
+
+bool CPresetCompiler::Has(const std::string& type) const
+{
+  for (const auto& stage : m_stages)
+  {
+    if (stage.type == type)
+      return true;
+  }
+  return false;
+}
+
+double CPresetCompiler::Param(const Stage& stage, const std::string& name, double fallback)
+{
+  auto it = stage.params.find(name);
+  return it != stage.params.end() ? std::atof(it->second.c_str()) : fallback;
+}
+
+std::string CPresetCompiler::Param(const Stage& stage, const std::string& name, const std::string& fallback)
+{
+  auto it = stage.params.find(name);
+  return it != stage.params.end() ? it->second : fallback;
+}
+
+std::string CPresetCompiler::Literal(double value)
+{
+  // GLSL ES needs a decimal point to make it a float
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.6g", value);
+  std::string literal = buffer;
+  if (literal.find_first_of(".e") == std::string::npos)
+    literal += ".";
+  return literal;
+}
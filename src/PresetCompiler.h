@@ -0,0 +1,121 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// The cell texture keeps the rain phase (0..1) in two 8 bit channels, the
+// high bits in red and the low bits in blue, so slow columns fade as
+// smoothly as in the per pixel shader. The FFT boost multiplies any step of
+// a single channel by up to 5.
+#define CELL_PHASE_STEPS (255.0)
+
+// Highest intensity of the CPU computed cells, stored square root encoded
+// to keep the dim end precise
+#define CELL_INTENSITY_RANGE (4.0)
+
+// The logo is a signed distance field, LOGO_SDF_SIZE texels square, storing
+// .5 - distance/(2*LOGO_SDF_SPREAD) with the distance in logo widths,
+// positive outside. Its edge is smoothed over LOGO_EDGE and the shadow
+// fades out over LOGO_SHADOW_WIDTH.
+#define LOGO_SDF_SIZE (128)
+#define LOGO_SDF_SPREAD (0.08)
+#define LOGO_EDGE (0.004)
+#define LOGO_SHADOW_WIDTH (0.06)
+
+// Compiles a preset, described as a list of stages in a .stages file, into
+// the main() of a fragment shader. Stages which are not used by anything
+// are dropped, parameters are folded into the generated code, and stages
+// that only depend on the cell (gv) can be moved into a separate pass that
+// runs once per cell instead of once per pixel.
+//
+// File format, one stage per line, '#' starts a comment:
+//   rain base=0.65
+//   fft coord=plain shape=falloff limit=1.99
+//   logo shadow=0.18 outline=0.01
+class CPresetCompiler
+{
+public:
+  enum Image
+  {
+    IMAGE_NONE = 0,
+    IMAGE_LOGO,
+    IMAGE_ALBUM,
+  };
+
+  // The stages as parameters for the CPU implementation, see CCellRenderer
+  struct CellProgram
+  {
+    float rainBase = 1.0f;
+    bool distortion = false;
+    Image image = IMAGE_NONE;
+    float logoShadow = 0.0f;
+    float logoOutline = 0.0f; // 0 for none
+    bool fft = false;
+    bool fftDistorted = false;
+    bool fftBoost = false;
+    float fftLimit = 0.0f; // 0 for none
+    bool waveform = false;
+    float envelopeLimit = -1.0f; // negative for none
+    bool noise = false;
+    float vignette = 0.0f;
+    float intensity = 1.0f;
+  };
+
+  struct Options
+  {
+    bool lowpower = false;
+    bool cellPass = false; // move cell-only stages into a cell pass
+    bool hybrid = false; // the CPU computes all cells, the shader draws dots
+  };
+
+  struct Result
+  {
+    bool ok = false;
+    std::string fragment;     // main() of the preset
+    std::string cellFragment; // main() of the cell pass, empty if none
+    CellProgram cellProgram;  // set in hybrid mode
+    float rainBase = 1.0f;    // of the rain stage
+    float vignette = 0.0f;    // intensity of the vignette stage, 0 for none
+  };
+
+  bool Load(const std::string& file);
+  bool Parse(const std::string& source);
+  Result Compile(const Options& options) const;
+
+private:
+  struct Stage
+  {
+    std::string type;
+    std::map<std::string, std::string> params;
+  };
+
+  bool Has(const std::string& type) const;
+  CellProgram CompileCells() const;
+  static double Param(const Stage& stage, const std::string& name, double fallback);
+  static std::string Param(const Stage& stage, const std::string& name, const std::string& fallback);
+  static std::string Literal(double value);
+
+  std::string m_file;
+  std::vector<Stage> m_stages;
+};
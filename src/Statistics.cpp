@@ -0,0 +1,92 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+CHistogram::CHistogram(const std::vector<double>& bounds)
+  : m_bounds(bounds),
+    m_buckets(bounds.size() + 1, 0)
+{
+}
+
+void CHistogram::Add(double value)
+{
+  size_t bucket = 0;
+  while (bucket < m_bounds.size() && value > m_bounds[bucket])
+    bucket++;
+  m_buckets[bucket]++;
+
+  if (!m_count || value < m_min)
+    m_min = value;
+  if (!m_count || value > m_max)
+    m_max = value;
+  m_sum += value;
+  m_count++;
+}
+
+void CHistogram::Reset()
+{
+  std::fill(m_buckets.begin(), m_buckets.end(), 0);
+  m_count = 0;
+  m_sum = 0.0;
+  m_min = 0.0;
+  m_max = 0.0;
+}
+
+std::string CHistogram::ToString() const
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "n=%u mean=%.2f min=%.2f max=%.2f [", m_count, Mean(), m_min, m_max);
+  std::string result = buffer;
+
+  bool first = true;
+  for (size_t i = 0; i < m_buckets.size(); i++)
+  {
+    if (!m_buckets[i])
+      continue;
+    if (i < m_bounds.size())
+      snprintf(buffer, sizeof(buffer), "%s<=%g:%u", first ? "" : " ", m_bounds[i], m_buckets[i]);
+    else
+      snprintf(buffer, sizeof(buffer), "%s>%g:%u", first ? "" : " ", m_bounds.empty() ? 0.0 : m_bounds.back(), m_buckets[i]);
+    result += buffer;
+    first = false;
+  }
+  return result + "]";
+}
+
+void CValueCounts::Add(int value)
+{
+  m_counts[value]++;
+}
+
+std::string CValueCounts::ToString() const
+{
+  std::string result;
+  for (const auto& count : m_counts)
+  {
+    if (!result.empty())
+      result += " ";
+    result += std::to_string(count.first) + ":" + std::to_string(count.second);
+  }
+  return "[" + result + "]";
+}
@@ -0,0 +1,66 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Counts values into buckets given by their upper bounds. Values above the
+// last bound go to an overflow bucket.
+class CHistogram
+{
+public:
+  CHistogram(const std::vector<double>& bounds);
+
+  void Add(double value);
+  void Reset();
+
+  unsigned int Count() const { return m_count; }
+  double Mean() const { return m_count ? m_sum / m_count : 0.0; }
+  double Min() const { return m_min; }
+  double Max() const { return m_max; }
+
+  // One line summary, e.g. "n=10 mean=1.5 min=1 max=2 [<=1:5 <=2:5]"
+  std::string ToString() const;
+
+private:
+  std::vector<double> m_bounds;
+  std::vector<unsigned int> m_buckets;
+  unsigned int m_count = 0;
+  double m_sum = 0.0;
+  double m_min = 0.0;
+  double m_max = 0.0;
+};
+
+// Counts how often each distinct value was seen
+class CValueCounts
+{
+public:
+  void Add(int value);
+  void Reset() { m_counts.clear(); }
+
+  size_t Distinct() const { return m_counts.size(); }
+  std::string ToString() const;
+
+private:
+  std::map<int, unsigned int> m_counts;
+};
@@ -0,0 +1,447 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TextureCompressor.h"
+
+#include <kodi/Filesystem.h>
+#include <kodi/General.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace
+{
+
+const char g_magic[4] = {'M', 'T', 'X', 'C'};
+const uint32_t g_version = 1;
+
+// ETC1 intensity modifier tables, in pixel index order
+const int g_etcModifiers[8][4] =
+{
+  {2, 8, -2, -8},
+  {5, 17, -5, -17},
+  {9, 29, -9, -29},
+  {13, 42, -13, -42},
+  {18, 60, -18, -60},
+  {24, 80, -24, -80},
+  {33, 106, -33, -106},
+  {47, 183, -47, -183},
+};
+
+inline int Clamp255(int value)
+{
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// Best table and pixel indices of one ETC1 subblock, returns the error
+int FitSubblock(const uint8_t* pixels, const int* members, const int base[3], int& table, int indices[16])
+{
+  int bestError = INT_MAX;
+  for (int t = 0; t < 8; t++)
+  {
+    int error = 0;
+    int chosen[8];
+    for (int i = 0; i < 8; i++)
+    {
+      const uint8_t* pixel = pixels + members[i] * 4;
+      int best = INT_MAX;
+      for (int m = 0; m < 4; m++)
+      {
+        int e = 0;
+        for (int c = 0; c < 3; c++)
+        {
+          int d = Clamp255(base[c] + g_etcModifiers[t][m]) - pixel[c];
+          e += d * d;
+        }
+        if (e < best)
+        {
+          best = e;
+          chosen[i] = m;
+        }
+      }
+      error += best;
+      if (error >= bestError)
+        break;
+    }
+    if (error < bestError)
+    {
+      bestError = error;
+      table = t;
+      for (int i = 0; i < 8; i++)
+        indices[members[i]] = chosen[i];
+    }
+  }
+  return bestError;
+}
+
+} // namespace
+
+size_t CTextureData::Bytes() const
+{
+  size_t bytes = 0;
+  for (const auto& level : levels)
+    bytes += level.data.size();
+  return bytes;
+}
+
+GLenum CTextureCompressor::SupportedFormat()
+{
+#if defined(HAS_GL)
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++)
+  {
+    const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+      return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  }
+  return 0;
+#elif defined(HAS_GLES) && HAS_GLES >= 3
+  return GL_COMPRESSED_RGB8_ETC2;
+#else
+  const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  if (extensions && strstr(extensions, "GL_OES_compressed_ETC1_RGB8_texture"))
+    return GL_ETC1_RGB8_OES;
+  return 0;
+#endif
+}
+
+const char* CTextureCompressor::FormatName(GLenum format)
+{
+  switch (format)
+  {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+      return "BC1";
+    case GL_COMPRESSED_RGB8_ETC2:
+      return "ETC2";
+    case GL_ETC1_RGB8_OES:
+      return "ETC1";
+    case 0:
+      return "RGBA";
+    default:
+      return "unknown";
+  }
+}
+
+bool CTextureCompressor::Compress(const CImage& image, GLenum format, CTextureData& texture)
+{
+  texture = CTextureData();
+  if (image.Empty() || !format)
+    return false;
+
+  texture.format = format;
+  CImage level = image;
+  while (true)
+  {
+    const int width = level.Width();
+    const int height = level.Height();
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+
+    CTextureData::Level output;
+    output.width = width;
+    output.height = height;
+    output.data.resize(blocksX * blocksY * 8);
+
+    uint8_t pixels[16 * 4];
+    for (int by = 0; by < blocksY; by++)
+    {
+      for (int bx = 0; bx < blocksX; bx++)
+      {
+        // Blocks over the edge repeat the last row and column
+        for (int y = 0; y < 4; y++)
+        {
+          const int sy = std::min(by * 4 + y, height - 1);
+          for (int x = 0; x < 4; x++)
+          {
+            const int sx = std::min(bx * 4 + x, width - 1);
+            memcpy(pixels + (y * 4 + x) * 4, level.Data() + (sy * width + sx) * 4, 4);
+          }
+        }
+
+        uint8_t* block = output.data.data() + (by * blocksX + bx) * 8;
+        if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+          EncodeBC1(pixels, block);
+        else
+          EncodeETC1(pixels, block);
+      }
+    }
+    texture.levels.push_back(std::move(output));
+
+    if (width == 1 && height == 1)
+      break;
+    level = level.Downscale(2);
+  }
+  return true;
+}
+
+void CTextureCompressor::EncodeBC1(const uint8_t* pixels, uint8_t* block)
+{
+  // Bounding box of the colors, inset a little to reduce the error of the
+  // extremes that are then not hit exactly
+  int low[3] = {255, 255, 255};
+  int high[3] = {0, 0, 0};
+  for (int i = 0; i < 16; i++)
+  {
+    for (int c = 0; c < 3; c++)
+    {
+      low[c] = std::min(low[c], static_cast<int>(pixels[i * 4 + c]));
+      high[c] = std::max(high[c], static_cast<int>(pixels[i * 4 + c]));
+    }
+  }
+  for (int c = 0; c < 3; c++)
+  {
+    int inset = (high[c] - low[c]) >> 4;
+    low[c] += inset;
+    high[c] -= inset;
+  }
+
+  auto pack = [](const int* color)
+  {
+    return static_cast<uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+  };
+  uint16_t color0 = pack(high);
+  uint16_t color1 = pack(low);
+
+  // color0 > color1 selects the four color mode
+  uint32_t indices = 0;
+  if (color0 < color1)
+    std::swap(color0, color1);
+  if (color0 != color1)
+  {
+    int palette[4][3];
+    for (int p = 0; p < 2; p++)
+    {
+      uint16_t color = p ? color1 : color0;
+      int r = (color >> 11) & 31;
+      int g = (color >> 5) & 63;
+      int b = color & 31;
+      palette[p][0] = (r << 3) | (r >> 2);
+      palette[p][1] = (g << 2) | (g >> 4);
+      palette[p][2] = (b << 3) | (b >> 2);
+    }
+    for (int c = 0; c < 3; c++)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+      int best = INT_MAX;
+      uint32_t index = 0;
+      for (uint32_t p = 0; p < 4; p++)
+      {
+        int e = 0;
+        for (int c = 0; c < 3; c++)
+        {
+          int d = palette[p][c] - pixels[i * 4 + c];
+          e += d * d;
+        }
+        if (e < best)
+        {
+          best = e;
+          index = p;
+        }
+      }
+      indices |= index << (i * 2);
+    }
+  }
+
+  block[0] = color0 & 0xFF;
+  block[1] = color0 >> 8;
+  block[2] = color1 & 0xFF;
+  block[3] = color1 >> 8;
+  for (int i = 0; i < 4; i++)
+    block[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+void CTextureCompressor::EncodeETC1(const uint8_t* pixels, uint8_t* block)
+{
+  uint64_t bestBits = 0;
+  int bestError = INT_MAX;
+
+  for (int flip = 0; flip < 2; flip++)
+  {
+    // Pixels of the two subblocks, side by side or on top of each other
+    int members[2][8];
+    int count[2] = {0, 0};
+    for (int y = 0; y < 4; y++)
+    {
+      for (int x = 0; x < 4; x++)
+      {
+        int half = flip ? (y >= 2) : (x >= 2);
+        members[half][count[half]++] = y * 4 + x;
+      }
+    }
+
+    int mean[2][3];
+    for (int half = 0; half < 2; half++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        int sum = 0;
+        for (int i = 0; i < 8; i++)
+          sum += pixels[members[half][i] * 4 + c];
+        mean[half][c] = (sum + 4) / 8;
+      }
+    }
+
+    // Differential mode keeps 5 bits per channel if the means are close
+    int quantized[2][3];
+    bool differential = true;
+    for (int half = 0; half < 2; half++)
+    {
+      for (int c = 0; c < 3; c++)
+        quantized[half][c] = (mean[half][c] * 31 + 127) / 255;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+      int delta = quantized[1][c] - quantized[0][c];
+      if (delta < -4 || delta > 3)
+        differential = false;
+    }
+
+    int base[2][3];
+    for (int half = 0; half < 2; half++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        if (differential)
+        {
+          base[half][c] = (quantized[half][c] << 3) | (quantized[half][c] >> 2);
+        }
+        else
+        {
+          quantized[half][c] = (mean[half][c] * 15 + 127) / 255;
+          base[half][c] = quantized[half][c] * 17;
+        }
+      }
+    }
+
+    int tables[2];
+    int indices[16];
+    int error = FitSubblock(pixels, members[0], base[0], tables[0], indices) +
+                FitSubblock(pixels, members[1], base[1], tables[1], indices);
+    if (error >= bestError)
+      continue;
+    bestError = error;
+
+    uint64_t bits = 0;
+    for (int c = 0; c < 3; c++)
+    {
+      const int shift = 59 - c * 8;
+      if (differential)
+      {
+        int delta = (quantized[1][c] - quantized[0][c]) & 7;
+        bits |= static_cast<uint64_t>(quantized[0][c]) << shift;
+        bits |= static_cast<uint64_t>(delta) << (shift - 3);
+      }
+      else
+      {
+        bits |= static_cast<uint64_t>(quantized[0][c]) << (shift + 1);
+        bits |= static_cast<uint64_t>(quantized[1][c]) << (shift - 3);
+      }
+    }
+    bits |= static_cast<uint64_t>(tables[0]) << 37;
+    bits |= static_cast<uint64_t>(tables[1]) << 34;
+    bits |= static_cast<uint64_t>(differential) << 33;
+    bits |= static_cast<uint64_t>(flip) << 32;
+
+    // Index bits are stored column by column, high bits first
+    for (int y = 0; y < 4; y++)
+    {
+      for (int x = 0; x < 4; x++)
+      {
+        int index = indices[y * 4 + x];
+        int position = x * 4 + y;
+        bits |= static_cast<uint64_t>(index >> 1) << (16 + position);
+        bits |= static_cast<uint64_t>(index & 1) << position;
+      }
+    }
+    bestBits = bits;
+  }
+
+  for (int i = 0; i < 8; i++)
+    block[i] = (bestBits >> (56 - i * 8)) & 0xFF;
+}
+
+bool CTextureCompressor::Save(const std::string& file, const CTextureData& texture)
+{
+  std::string directory = file.substr(0, file.find_last_of("/\\") + 1);
+  if (!kodi::vfs::DirectoryExists(directory))
+    kodi::vfs::CreateDirectory(directory);
+
+  kodi::vfs::CFile output;
+  if (!output.OpenFileForWrite(file, true))
+    return false;
+
+  uint32_t header[3] = {g_version, static_cast<uint32_t>(texture.format), static_cast<uint32_t>(texture.levels.size())};
+  output.Write(g_magic, sizeof(g_magic));
+  output.Write(header, sizeof(header));
+  for (const auto& level : texture.levels)
+  {
+    uint32_t info[3] = {static_cast<uint32_t>(level.width), static_cast<uint32_t>(level.height), static_cast<uint32_t>(level.data.size())};
+    output.Write(info, sizeof(info));
+    output.Write(level.data.data(), level.data.size());
+  }
+  output.Close();
+  return true;
+}
+
+bool CTextureCompressor::Load(const std::string& file, CTextureData& texture)
+{
+  texture = CTextureData();
+
+  kodi::vfs::CFile input;
+  if (!kodi::vfs::FileExists(file) || !input.OpenFile(file))
+    return false;
+
+  char magic[4];
+  uint32_t header[3];
+  bool ok = input.Read(magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, g_magic, sizeof(magic)) == 0 &&
+            input.Read(header, sizeof(header)) == sizeof(header) && header[0] == g_version && header[2] < 32;
+  if (ok)
+  {
+    texture.format = header[1];
+    for (uint32_t i = 0; i < header[2] && ok; i++)
+    {
+      uint32_t info[3];
+      ok = input.Read(info, sizeof(info)) == sizeof(info) && info[2] == ((info[0] + 3) / 4) * ((info[1] + 3) / 4) * 8;
+      if (!ok)
+        break;
+      CTextureData::Level level;
+      level.width = info[0];
+      level.height = info[1];
+      level.data.resize(info[2]);
+      ok = input.Read(level.data.data(), info[2]) == static_cast<ssize_t>(info[2]);
+      texture.levels.push_back(std::move(level));
+    }
+  }
+  input.Close();
+
+  if (!ok)
+  {
+    kodi::Log(ADDON_LOG_WARNING, "Ignoring damaged texture cache file %s", file.c_str());
+    texture = CTextureData();
+  }
+  return ok;
+}
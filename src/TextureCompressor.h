@@ -0,0 +1,78 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "Image.h"
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+// Mip chain of a texture in a compressed GPU format
+struct CTextureData
+{
+  struct Level
+  {
+    int width;
+    int height;
+    std::vector<uint8_t> data;
+  };
+
+  GLenum format = 0;
+  std::vector<Level> levels;
+
+  bool Empty() const { return levels.empty(); }
+  size_t Bytes() const;
+};
+
+// Fast CPU encoders for 8 byte per 4x4 block RGB formats: BC1 (DXT1) for
+// desktop GL and ETC1 blocks, which are valid ETC2 as well, for GLES. They
+// pick endpoints from the block's bounding box and base colors from the
+// subblock means, good enough for album covers shown through the dots.
+class CTextureCompressor
+{
+public:
+  // Best supported format of the current context, 0 for none
+  static GLenum SupportedFormat();
+  static const char* FormatName(GLenum format);
+
+  // Compresses the image and its mip chain down to 1x1
+  static bool Compress(const CImage& image, GLenum format, CTextureData& texture);
+
+  static bool Save(const std::string& file, const CTextureData& texture);
+  static bool Load(const std::string& file, CTextureData& texture);
+
+private:
+  static void EncodeBC1(const uint8_t* pixels, uint8_t* block);
+  static void EncodeETC1(const uint8_t* pixels, uint8_t* block);
+};
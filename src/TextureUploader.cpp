@@ -0,0 +1,199 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TextureUploader.h"
+
+#include <kodi/General.h>
+
+#include <algorithm>
+#include <chrono>
+
+// Bytes uploaded per frame, bounds and start value
+#define UPLOAD_BUDGET_MIN (64 * 1024)
+#define UPLOAD_BUDGET_MAX (8 * 1024 * 1024)
+#define UPLOAD_BUDGET_START (256 * 1024)
+
+// Share of the average frame time the uploads may take
+#define UPLOAD_FRAME_SHARE (0.2)
+
+// A frame this much longer than average counts as a spike
+#define UPLOAD_SPIKE_FACTOR (1.25)
+
+CTextureUploader::CTextureUploader(CGLDeletionQueue& deletionQueue)
+  : m_deletionQueue(deletionQueue)
+{
+}
+
+void CTextureUploader::Start(const CImage& image, GLint scaling, GLint repeat)
+{
+  Cancel();
+  if (image.Empty())
+    return;
+
+  m_image = image;
+  m_row = 0;
+  m_plainBytes = static_cast<size_t>(image.Width()) * image.Height() * 4;
+  Allocate(scaling, scaling, repeat);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_image.Width(), m_image.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CTextureUploader::Start(const CTextureData& texture, GLint scaling, GLint repeat)
+{
+  Cancel();
+  if (texture.Empty())
+    return;
+
+  m_compressed = texture;
+  m_level = static_cast<int>(m_compressed.levels.size()) - 1;
+  m_plainBytes = static_cast<size_t>(texture.levels[0].width) * texture.levels[0].height * 4;
+
+#if defined(HAS_GLES) && HAS_GLES == 2
+  // GLES 2 has no mipmaps for sizes other than powers of two
+  const int width = m_compressed.levels[0].width;
+  const int height = m_compressed.levels[0].height;
+  if ((width & (width - 1)) || (height & (height - 1)))
+    m_level = 0;
+#endif
+
+  GLint minFilter = scaling;
+  if (m_level > 0)
+    minFilter = scaling == GL_NEAREST ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR;
+  Allocate(minFilter, scaling, repeat);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CTextureUploader::Allocate(GLint minFilter, GLint magFilter, GLint repeat)
+{
+  if (!m_budget)
+    m_budget = UPLOAD_BUDGET_START;
+  m_frames = 0;
+
+  glGenTextures(1, &m_texture);
+  glBindTexture(GL_TEXTURE_2D, m_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, repeat);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, repeat);
+}
+
+GLuint CTextureUploader::Step()
+{
+  if (!m_texture)
+    return 0;
+
+  m_frames++;
+  if (!m_compressed.Empty())
+  {
+    // Whole levels, at least one per frame
+    size_t bytes = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    while (m_level >= 0)
+    {
+      const CTextureData::Level& level = m_compressed.levels[m_level];
+      if (bytes && bytes + level.data.size() > m_budget)
+        break;
+      glCompressedTexImage2D(GL_TEXTURE_2D, m_level, m_compressed.format, level.width, level.height, 0,
+                             static_cast<GLsizei>(level.data.size()), level.data.data());
+      bytes += level.data.size();
+      m_level--;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    MeasureSpeed(bytes, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    m_textureBytes += bytes;
+
+    if (m_level >= 0)
+      return 0;
+    return Finish(m_compressed.levels[0].width, m_compressed.levels[0].height);
+  }
+
+  const size_t stride = static_cast<size_t>(m_image.Width()) * 4;
+  int rows = static_cast<int>(std::max<size_t>(m_budget / stride, 1));
+  rows = std::min(rows, m_image.Height() - m_row);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  glBindTexture(GL_TEXTURE_2D, m_texture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_row, m_image.Width(), rows, GL_RGBA, GL_UNSIGNED_BYTE, m_image.Data() + m_row * stride);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  MeasureSpeed(rows * stride, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+  m_textureBytes += rows * stride;
+
+  m_row += rows;
+  if (m_row < m_image.Height())
+    return 0;
+  return Finish(m_image.Width(), m_image.Height());
+}
+
+void CTextureUploader::MeasureSpeed(size_t bytes, double ms)
+{
+  // Upload speed as seen by the render thread, smoothed
+  if (ms > 0.0)
+  {
+    double speed = bytes / ms;
+    m_bytesPerMs = m_bytesPerMs > 0.0 ? m_bytesPerMs * 0.75 + speed * 0.25 : speed;
+  }
+}
+
+GLuint CTextureUploader::Finish(int width, int height)
+{
+  kodi::Log(ADDON_LOG_DEBUG, "Uploaded %ix%i %s texture in %i frames, budget now %u KiB",
+            width, height, CTextureCompressor::FormatName(m_compressed.format), m_frames,
+            static_cast<unsigned int>(m_budget / 1024));
+  GLuint texture = m_texture;
+  m_texture = 0;
+  m_image = CImage();
+  m_compressed = CTextureData();
+  return texture;
+}
+
+void CTextureUploader::FrameTime(double ms)
+{
+  if (!m_budget)
+    return;
+
+  bool spike = m_averageFrame > 0.0 && ms > m_averageFrame * UPLOAD_SPIKE_FACTOR;
+  m_averageFrame = m_averageFrame > 0.0 ? m_averageFrame * 0.9 + ms * 0.1 : ms;
+
+  // Back off fast on a long frame, grow slowly otherwise
+  if (spike)
+    m_budget /= 2;
+  else
+    m_budget += m_budget / 8;
+
+  if (m_bytesPerMs > 0.0)
+    m_budget = std::min(m_budget, static_cast<size_t>(m_bytesPerMs * m_averageFrame * UPLOAD_FRAME_SHARE));
+  m_budget = std::min(std::max(m_budget, static_cast<size_t>(UPLOAD_BUDGET_MIN)), static_cast<size_t>(UPLOAD_BUDGET_MAX));
+}
+
+void CTextureUploader::Cancel()
+{
+  m_deletionQueue.DeleteTexture(m_texture);
+  m_texture = 0;
+  m_textureBytes = 0;
+  m_plainBytes = 0;
+  m_image = CImage();
+  m_compressed = CTextureData();
+}
+
+void CTextureUploader::Forget()
+{
+  m_texture = 0;
+}
@@ -0,0 +1,88 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "GLDeletionQueue.h"
+#include "Image.h"
+#include "TextureCompressor.h"
+
+#include <kodi/gui/gl/Shader.h>
+
+// Streams an image into a texture over several frames. The texture is
+// allocated once, then filled in row bands with glTexSubImage2D, at most
+// Budget() bytes per frame. A single large glTexImage2D stalls the frame it
+// happens in on drivers without a shared upload context.
+//
+// The budget adapts to the headroom of the frames: it shrinks quickly when
+// a frame took longer than usual and the uploads may only take a share of
+// the average frame time at the measured upload speed.
+//
+// Compressed textures can't be updated in parts on all drivers, they are
+// uploaded a whole mip level at a time, smallest first.
+class CTextureUploader
+{
+public:
+  explicit CTextureUploader(CGLDeletionQueue& deletionQueue);
+
+  // Replaces a pending upload, the previous texture is deleted
+  void Start(const CImage& image, GLint scaling, GLint repeat);
+  void Start(const CTextureData& texture, GLint scaling, GLint repeat);
+
+  // Uploads the next band. Returns the texture once it is complete, the
+  // caller owns it then.
+  GLuint Step();
+
+  // GPU memory of the texture Step() returned last, in bytes
+  size_t TextureBytes() const { return m_textureBytes; }
+  // Same as RGBA, for comparison
+  size_t PlainBytes() const { return m_plainBytes; }
+
+  // Interval of the last frame, in ms
+  void FrameTime(double ms);
+
+  bool Busy() const { return m_texture != 0; }
+  bool Compressed() const { return !m_compressed.Empty(); }
+  size_t Budget() const { return m_budget; }
+
+  // Drops the pending upload
+  void Cancel();
+  // Drops the pending texture without deleting, for a lost context
+  void Forget();
+
+private:
+  void Allocate(GLint minFilter, GLint magFilter, GLint repeat);
+  GLuint Finish(int width, int height);
+  void MeasureSpeed(size_t bytes, double ms);
+
+  CGLDeletionQueue& m_deletionQueue;
+  CImage m_image;
+  CTextureData m_compressed;
+  GLuint m_texture = 0;
+  size_t m_textureBytes = 0;
+  size_t m_plainBytes = 0;
+  int m_row = 0;
+  int m_level = 0; // next compressed level, counting down
+  int m_frames = 0;
+
+  size_t m_budget = 0; // bytes per frame, 0 until the first Start()
+  double m_averageFrame = 0.0; // ms
+  double m_bytesPerMs = 0.0; // measured upload speed
+};
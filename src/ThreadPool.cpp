@@ -0,0 +1,104 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+CThreadPool::CThreadPool(unsigned int threads)
+{
+  for (unsigned int i = 0; i < std::max(threads, 1u); i++)
+    m_workers.emplace_back(&CThreadPool::Work, this);
+}
+
+CThreadPool::~CThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_all();
+  for (auto& worker : m_workers)
+    worker.join();
+}
+
+void CThreadPool::Submit(std::function<void()> job)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(job));
+  }
+  m_condition.notify_one();
+}
+
+unsigned int CThreadPool::DefaultThreads()
+{
+  unsigned int cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;
+}
+
+void CThreadPool::Work()
+{
+  while (true)
+  {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+      if (m_stop && m_jobs.empty())
+        return;
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    job();
+  }
+}
+
+CTaskGroup::~CTaskGroup()
+{
+  Wait();
+}
+
+void CTaskGroup::Run(CThreadPool& pool, std::function<void()> job)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending++;
+  }
+  pool.Submit([this, job]
+  {
+    job();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_pending == 0)
+      m_done.notify_all();
+  });
+}
+
+void CTaskGroup::Wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this] { return m_pending == 0; });
+}
+
+bool CTaskGroup::Busy()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pending != 0;
+}
@@ -0,0 +1,67 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs
+class CThreadPool
+{
+public:
+  explicit CThreadPool(unsigned int threads);
+  ~CThreadPool();
+
+  unsigned int Threads() const { return static_cast<unsigned int>(m_workers.size()); }
+  void Submit(std::function<void()> job);
+
+  // Workers for the current machine, leaves one core to Kodi's render thread
+  static unsigned int DefaultThreads();
+
+private:
+  void Work();
+
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop = false;
+};
+
+// Jobs submitted together, Wait() returns once all of them have finished
+class CTaskGroup
+{
+public:
+  ~CTaskGroup();
+
+  void Run(CThreadPool& pool, std::function<void()> job);
+  void Wait();
+  bool Busy();
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_done;
+  int m_pending = 0;
+};
@@ -0,0 +1,230 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "VariableRate.h"
+
+#include <kodi/General.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Darkening by the vignette from which the dots are shaded at the coarse
+// rate, bw is about 1 for a bright dot
+#define VARIABLE_RATE_THRESHOLD (0.03f)
+
+// Smallest dot cell in pixels shaded at the coarse rate, below it the 2x2
+// blocks alias with the dot grid
+#define VARIABLE_RATE_MIN_CELL (4.0f)
+
+namespace
+{
+
+const std::string g_upscaleMain =
+R"upscale(
+uniform sampler2D iCoarse;
+
+void main(void)
+{
+  FragColor = vec4(texture(iCoarse, gl_FragCoord.xy*.5/cCoarseSize).rgb, 1.);
+}
+)upscale";
+
+}
+
+CVariableRate::CVariableRate(CGLDeletionQueue& deletionQueue)
+  : m_deletionQueue(deletionQueue),
+    m_upscale(new kodi::gui::gl::CShaderProgram)
+{
+}
+
+CVariableRate::~CVariableRate()
+{
+  Unload();
+}
+
+std::string CVariableRate::Defines()
+{
+#if defined(HAS_GL)
+  std::string defines = "uniform float iPixelScale;\n";
+  defines += "#undef FRAG_UV\n";
+  defines += "#define FRAG_UV ((gl_FragCoord.xy*iPixelScale-0.5*iResolution.xy)/iResolution.y)\n";
+  defines += "#undef NOISE_COORD\n";
+  defines += "#define NOISE_COORD (gl_FragCoord.xy*iPixelScale/(256.*iDotSize))\n";
+  return defines;
+#else
+  // The varyings are interpolated over the viewport, they fit any size
+  return "";
+#endif
+}
+
+bool CVariableRate::Setup(int width, int height, float vignette, float cellSize)
+{
+  m_width = width;
+  m_height = height;
+  m_outer.clear();
+  if (vignette <= 0.0f || cellSize < VARIABLE_RATE_MIN_CELL)
+    return false;
+
+  // The vignette is 'length(uv)*intensity' and uv.y spans the height. The
+  // region ends on whole cells from the center, no dot is split between
+  // the rates, and on even pixels, where the coarse blocks start.
+  const float radius = VARIABLE_RATE_THRESHOLD / vignette * height;
+  const float extent = std::ceil(radius / cellSize) * cellSize;
+  auto clampEven = [](float value, int size)
+  {
+    return std::min(std::max(static_cast<int>(std::floor(value * 0.5f)) * 2, 0), size);
+  };
+  const int x0 = clampEven(width * 0.5f - extent, width);
+  const int x1 = clampEven(width * 0.5f + extent + 1.0f, width);
+  const int y0 = clampEven(height * 0.5f - extent, height);
+  const int y1 = clampEven(height * 0.5f + extent + 1.0f, height);
+  m_center[0] = x0;
+  m_center[1] = y0;
+  m_center[2] = x1 - x0;
+  m_center[3] = y1 - y0;
+
+  if (y0 > 0)
+    m_outer.push_back({0, 0, width, y0});
+  if (y1 < height)
+    m_outer.push_back({0, y1, width, height - y1});
+  if (x0 > 0)
+    m_outer.push_back({0, y0, x0, y1 - y0});
+  if (x1 < width)
+    m_outer.push_back({x1, y0, width - x1, y1 - y0});
+  return !m_outer.empty();
+}
+
+bool CVariableRate::Load(const std::string& vertexShader, const std::string& fragmentShader,
+                         const std::string& vertexDefines, const std::string& defines)
+{
+  Unload();
+
+  const int coarseWidth = (m_width + 1) / 2;
+  const int coarseHeight = (m_height + 1) / 2;
+  const std::string size = "const vec2 cCoarseSize = vec2(" + std::to_string(coarseWidth) + ".," + std::to_string(coarseHeight) + ".);\n";
+  if (!m_upscale->LoadShaderFiles(vertexShader, fragmentShader) ||
+      !m_upscale->CompileAndLink(vertexDefines, "", defines, size + g_upscaleMain))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to compile the variable rate upscale shader");
+    return false;
+  }
+  m_coarseLoc = glGetUniformLocation(m_upscale->ProgramHandle(), "iCoarse");
+  m_vertexLoc = glGetAttribLocation(m_upscale->ProgramHandle(), "vertex");
+
+  glActiveTexture(GL_TEXTURE0);
+  glGenTextures(1, &m_texture);
+  glBindTexture(GL_TEXTURE_2D, m_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, coarseWidth, coarseHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &m_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return true;
+}
+
+void CVariableRate::Unload()
+{
+  m_deletionQueue.DeleteTexture(m_texture);
+  m_deletionQueue.DeleteFramebuffer(m_framebuffer);
+  m_texture = 0;
+  m_framebuffer = 0;
+  m_upscale.reset(new kodi::gui::gl::CShaderProgram);
+}
+
+void CVariableRate::Forget()
+{
+  // See CVisualizationMatrix::ForgetGLResources()
+  m_upscale.release();
+  m_upscale.reset(new kodi::gui::gl::CShaderProgram);
+  m_texture = 0;
+  m_framebuffer = 0;
+}
+
+size_t CVariableRate::Bytes() const
+{
+  return static_cast<size_t>((m_width + 1) / 2) * ((m_height + 1) / 2) * 4;
+}
+
+float CVariableRate::Shaded() const
+{
+  const float total = static_cast<float>(m_width) * m_height;
+  if (total <= 0.0f)
+    return 1.0f;
+  const float center = static_cast<float>(m_center[2]) * m_center[3];
+  return (center + (total - center) * 0.25f) / total;
+}
+
+void CVariableRate::Render(GLuint framebuffer, GLint pixelScaleLoc, GLuint vertexBuffer, const std::function<void()>& draw)
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+  glEnable(GL_SCISSOR_TEST);
+
+  // Periphery at the coarse rate. One more block around each region, the
+  // linear filter of the upscale reads it at the border.
+  const int coarseWidth = (m_width + 1) / 2;
+  const int coarseHeight = (m_height + 1) / 2;
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glViewport(0, 0, coarseWidth, coarseHeight);
+  glUniform1f(pixelScaleLoc, 2.0f);
+  for (const auto& region : m_outer)
+  {
+    int x0 = std::max(region[0] / 2 - 1, 0);
+    int y0 = std::max(region[1] / 2 - 1, 0);
+    int x1 = std::min((region[0] + region[2] + 1) / 2 + 1, coarseWidth);
+    int y1 = std::min((region[1] + region[3] + 1) / 2 + 1, coarseHeight);
+    glScissor(x0, y0, x1 - x0, y1 - y0);
+    draw();
+  }
+
+  // Center at full rate
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glUniform1f(pixelScaleLoc, 1.0f);
+  glScissor(viewport[0] + m_center[0], viewport[1] + m_center[1], m_center[2], m_center[3]);
+  draw();
+
+  // Periphery scaled up around it
+  glUseProgram(m_upscale->ProgramHandle());
+  glActiveTexture(GL_TEXTURE0);
+  glUniform1i(m_coarseLoc, 0);
+  glBindTexture(GL_TEXTURE_2D, m_texture);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  glVertexAttribPointer(m_vertexLoc, 4, GL_FLOAT, 0, 16, 0);
+  glEnableVertexAttribArray(m_vertexLoc);
+  for (const auto& region : m_outer)
+  {
+    glScissor(viewport[0] + region[0], viewport[1] + region[1], region[2], region[3]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+  }
+  glDisableVertexAttribArray(m_vertexLoc);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  if (!scissor)
+    glDisable(GL_SCISSOR_TEST);
+}
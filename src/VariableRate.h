@@ -0,0 +1,85 @@
+/*
+ *      Copyright (C) 2005-2019 Team Kodi
+ *      http://kodi.tv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Kodi; see the file COPYING.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "GLDeletionQueue.h"
+
+#include <kodi/gui/gl/Shader.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Emulates variable rate shading. The vignette of the presets darkens the
+// screen towards the edges, detail is hard to see there. The center is
+// shaded at full rate, the rest at one shading per 2x2 pixels into a
+// quarter size target which is scaled up into the frame. The regions are
+// rectangles on the cell grid, drawn with scissor tests.
+class CVariableRate
+{
+public:
+  explicit CVariableRate(CGLDeletionQueue& deletionQueue);
+  ~CVariableRate();
+
+  // Header lines of the preset, before the functions which use FRAG_UV and
+  // NOISE_COORD. The preset's iPixelScale is 2 in the coarse pass.
+  static std::string Defines();
+
+  // Full rate region of a preset, vignette is its intensity per unit of uv
+  // and cellSize the size of a dot cell in pixels. Returns false if there
+  // is nothing to gain: no vignette, or dots too small for 2x2 shading.
+  bool Setup(int width, int height, float vignette, float cellSize);
+
+  // Creates the coarse target and the program scaling it up, built from the
+  // same files and headers as the preset
+  bool Load(const std::string& vertexShader, const std::string& fragmentShader,
+            const std::string& vertexDefines, const std::string& defines);
+  void Unload();
+  // Drops the GL objects without deleting, for a lost context
+  void Forget();
+
+  // Bytes of the coarse target
+  size_t Bytes() const;
+  // Shading cost against shading every pixel
+  float Shaded() const;
+  // Full rate region in pixels, x, y, width, height
+  const int* Center() const { return m_center; }
+
+  // Draws the frame into framebuffer with the preset's program bound. The
+  // draw function issues the preset's draw call, it is called once per
+  // region.
+  void Render(GLuint framebuffer, GLint pixelScaleLoc, GLuint vertexBuffer, const std::function<void()>& draw);
+
+private:
+  CGLDeletionQueue& m_deletionQueue;
+  std::unique_ptr<kodi::gui::gl::CShaderProgram> m_upscale;
+  GLuint m_texture = 0;
+  GLuint m_framebuffer = 0;
+  GLint m_coarseLoc = -1;
+  GLint m_vertexLoc = -1;
+
+  int m_width = 0;
+  int m_height = 0;
+  int m_center[4] = {0};
+  std::vector<std::array<int, 4>> m_outer; // regions around the center
+};
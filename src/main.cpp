@@ -41,9 +41,56 @@
 #define MIN_DECIBELS (-100.0)
 #define MAX_DECIBELS (-30.0)
 
+// Shader variant autotuning: timed frames per variant, one per Render()
+// call, the allowed mean difference to the reference image (in 8 bit
+// levels) and how much faster than the default a variant has to be. The
+// median of the frames is compared, single frames stalled by the rest of
+// the GUI do not decide the result that is kept in the device profile.
+#define VARIANT_TUNE_FRAMES (300)
+#define VARIANT_TUNE_TOLERANCE (1.0)
+#define VARIANT_TUNE_MARGIN (0.05)
+
+#define DOT_LUT_SIZE (32)
+
+// Longest wait for the GPU to finish an older frame, in nanoseconds
+#define FRAME_FENCE_TIMEOUT (50000000)
+
+// Seconds between two statistics reports in the log
+#define STATISTICS_INTERVAL (60.0)
+
+// Seconds each preset is measured per quality tier by the self-benchmark
+#define BENCHMARK_TIME (3.0)
+
+// Seconds each transition scenario of the self-benchmark runs
+#define SCENARIO_TIME (5.0)
+
+// A frame counts as stall if it took this many times the median frame
+#define SCENARIO_STALL_FACTOR (2.0)
+
+// Seconds the analysis state layouts are measured under contention
+#define CONTENTION_TIME (0.5)
+
+// Seconds a captured frame is drawn again by the frame replay
+#define REPLAY_TIME (10.0)
+
+// GPU memory for compressed album covers kept for reuse, in bytes
+#define ALBUM_CACHE_BUDGET (32 * 1024 * 1024)
+
 #define AUDIO_BUFFER (1024)
 #define NUM_BANDS (AUDIO_BUFFER / 2)
 
+// Analysis tiers from best to cheapest, stepped through by the governor when
+// the analysis exceeds the configured CPU budget. Every tier is spread to
+// NUM_BANDS bands, so the shaders always see the same texture layout.
+const std::vector<AnalysisTier> g_analysisTiers =
+{
+  {AUDIO_BUFFER,     1, true},
+  {AUDIO_BUFFER,     2, true},
+  {AUDIO_BUFFER / 2, 2, true},
+  {AUDIO_BUFFER / 2, 2, false},
+  {AUDIO_BUFFER / 4, 4, false},
+};
+
 // Override GL_RED if not present with GL_LUMINANCE, e.g. on Android GLES
 #ifndef GL_RED
 #define GL_RED GL_LUMINANCE
@@ -61,16 +108,93 @@ struct Preset
 //       as they can cause problems on weaker systems.
 const std::vector<Preset> g_presets =
 {
-   {"Kodi",                         30100, "kodi.frag.glsl",        99,  0,  1, -1},
-   {"Album",                        30101, "album.frag.glsl",       99, -1,  1,  2},
-   {"Rain only",                    30102, "nologo.frag.glsl",      99, -1,  1, -1},
-   {"Rain with waveform",           30103, "nologowf.frag.glsl",    99, -1,  1, -1},
-   {"Rain with waveform envelope",  30104, "nologowfenv.frag.glsl", 99, -1,  1, -1},
-   {"Clean",                        30105, "clean.frag.glsl",       99, -1, -1, -1},
-   {"Clean with waveform",          30106, "cleanwf.frag.glsl",     99, -1, -1, -1},
-   {"Clean with waveform envelope", 30107, "cleanwfenv.frag.glsl",  99, -1, -1, -1},
+   {"Kodi",                         30100, "kodi.stages",           99,  0,  1, -1},
+   {"Album",                        30101, "album.stages",          99, -1,  1,  2},
+   {"Rain only",                    30102, "nologo.stages",         99, -1,  1, -1},
+   {"Rain with waveform",           30103, "nologowf.stages",       99, -1,  1, -1},
+   {"Rain with waveform envelope",  30104, "nologowfenv.stages",    99, -1,  1, -1},
+   {"Clean",                        30105, "clean.stages",          99, -1, -1, -1},
+   {"Clean with waveform",          30106, "cleanwf.stages",        99, -1, -1, -1},
+   {"Clean with waveform envelope", 30107, "cleanwfenv.stages",     99, -1, -1, -1},
+};
+
+// Equivalent ways to compile a preset, picked per GPU by the autotuner.
+// There is no table for h11(): the rain speed comes from it and gets
+// multiplied by the time, so any quantization shows up as drift after a few
+// minutes. The vignette is a single length() per pixel, which a texture
+// fetch would not beat.
+enum ShaderVariant
+{
+  SHADER_VARIANT_DEFAULT = 0,
+  SHADER_VARIANT_HIGHP = 1 << 0,   // highp instead of mediump on GLES
+  SHADER_VARIANT_DOT_LUT = 1 << 1, // dot shape from a baked texture
 };
 
+//background vertex, split at the center for the GLES varyings
+static const GLfloat g_vertexData[] =
+{
+  -1.0, 1.0, 1.0, 1.0,
+  -1.0,-1.0, 1.0, 1.0,
+   0.0, 1.0, 1.0, 1.0,
+   0.0,-1.0, 1.0, 1.0,
+   1.0, 1.0, 1.0, 1.0,
+   1.0,-1.0, 1.0, 1.0,
+};
+
+// Quality tiers measured by the self-benchmark
+struct BenchmarkTier
+{
+  std::string name;
+  bool lowpower;
+  bool cellPass;
+  bool hybrid;
+  CheckerboardMode checkerboard;
+  bool variableRate;
+};
+
+const std::vector<BenchmarkTier> g_benchmarkTiers =
+{
+  {"normal",       false, true,  false, CHECKERBOARD_OFF,      false},
+  {"lowpower",     true,  true,  false, CHECKERBOARD_OFF,      false},
+  {"perpixel",     false, false, false, CHECKERBOARD_OFF,      false},
+  {"hybrid",       false, true,  true,  CHECKERBOARD_OFF,      false},
+  {"checkerboard", false, true,  false, CHECKERBOARD_TEMPORAL, false},
+  {"halfwidth",    false, true,  false, CHECKERBOARD_SPATIAL,  false},
+  {"variablerate", false, true,  false, CHECKERBOARD_OFF,      true},
+};
+
+// Transition scenarios run by the self-benchmark after the presets, each one
+// repeats its action at the given interval while the frames are shown
+enum BenchmarkAction
+{
+  SCENARIO_NEXT_PRESET,
+  SCENARIO_RANDOM_PRESET,
+  SCENARIO_ALBUM,
+  SCENARIO_RESIZE,
+  SCENARIO_STOP_START,
+};
+
+struct BenchmarkScenario
+{
+  std::string name;
+  double interval; // s
+  BenchmarkAction action;
+};
+
+const std::vector<BenchmarkScenario> g_benchmarkScenarios =
+{
+  {"presetstorm", 0.1, SCENARIO_NEXT_PRESET},
+  {"randomstorm", 0.1, SCENARIO_RANDOM_PRESET},
+  {"albumstorm",  0.2, SCENARIO_ALBUM},
+  {"resizestorm", 0.5, SCENARIO_RESIZE},
+  {"stopstart",   0.5, SCENARIO_STOP_START},
+};
+
+// Bucket bounds of the telemetry histograms
+const std::vector<double> g_intervalBounds = {1, 2, 5, 10, 15, 20, 30, 50, 100, 200}; // ms
+const std::vector<double> g_lengthBounds = {64, 128, 256, 512, 1024, 2048, 4096, 8192}; // samples
+const std::vector<double> g_durationBounds = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000}; // us
+
 const std::vector<std::string> g_fileTextures =
 {
   "logo.png",
@@ -85,7 +209,7 @@ R"functions(float h11(float p)
 
 float waveform(vec2 uv)
 {
-  float wave = texture(iChannel0,vec2(uv.x*.15+.5,0.75)).x - .5;
+  float wave = texture(iChannel0,WAVEFORM_COORD(uv)).x - .5;
   return min(abs(uv.y*20.+wave*10.),0.5);
 }
 
@@ -93,7 +217,7 @@ float waveform(vec2 uv)
 float noise(vec2 gv)
 {
 	//return texture(iChannel2, vec2(gl_FragCoord.xy/(256.*iDotSize) +iTime*cNoiseFluctuation)).x;
-	return texture(iChannel2, vec2(gl_FragCoord.xy/(256.*iDotSize))).x;
+	return texture(iChannel2, NOISE_COORD).x;
 }
 #endif
 
@@ -115,7 +239,7 @@ R"functions(float h11(float p)
 
 float waveform(vec2 uv)
 {
-  float wave = texture(iChannel0,vec2(uv.x*.15+.5,0.75)).x*.5 + uv.y;
+  float wave = texture(iChannel0,WAVEFORM_COORD(uv)).x*.5 + uv.y;
   return abs(smoothstep(.225,.275,wave) -.5);
 }
 
@@ -127,6 +251,13 @@ float noise(vec2 gv)
 }
 #endif
 
+#ifdef dDotLUT
+vec3 bw2col(float bw, vec2 uv)
+{
+  vec2 dotshape = texture(iDotLUT, uv*cColumns).xy;
+  return (dotshape.y*cColor+dotshape.x)*bw;
+}
+#else
 vec3 bw2col(float bw, vec2 uv)
 {
   float d = length(fract(uv*cColumns)-.5);
@@ -134,15 +265,33 @@ vec3 bw2col(float bw, vec2 uv)
   float basecolor = smoothstep(.85,.0,d)*bw;
   return basecolor*cColor+peakcolor;
 }
+#endif
 
 )functions";
 
 CVisualizationMatrix::CVisualizationMatrix()
-  : m_kissCfg(kiss_fft_alloc(AUDIO_BUFFER, 0, nullptr, nullptr)),
-    m_audioData(new GLubyte[AUDIO_BUFFER]()),
-    m_magnitudeBuffer(new float[NUM_BANDS]()),
-    m_pcm(new float[AUDIO_BUFFER]())
+  : m_analysis(AUDIO_BUFFER, NUM_BANDS),
+    m_governor(g_analysisTiers),
+    m_profile(kodi::GetBaseUserPath("device_profile.txt")),
+    m_audioRows(NUM_BANDS, 2, AUDIO_TEXTURE_RING),
+    m_matrixShader(new kodi::gui::gl::CShaderProgram),
+    m_cellShader(new kodi::gui::gl::CShaderProgram),
+    m_albumUploader(m_deletionQueue),
+    m_albumCache(m_deletionQueue, ALBUM_CACHE_BUDGET),
+    m_checkerboard(m_deletionQueue),
+    m_variableRate(m_deletionQueue),
+    m_audioInterval(g_intervalBounds),
+    m_audioLength(g_lengthBounds),
+    m_analysisTime(g_durationBounds),
+    m_frameInterval(g_intervalBounds),
+    m_fenceWait(g_durationBounds)
 {
+  m_profile.Load();
+  bool retune = kodi::GetSettingBoolean("fftretune");
+  SetupFFTEngines(retune);
+  if (retune)
+    kodi::SetSettingBoolean("fftretune", false);
+
   m_currentPreset = kodi::GetSettingInt("lastpresetidx");
   m_dotSize = static_cast<float>(kodi::GetSettingInt("dotsize"));
   m_fallSpeed = static_cast<float>(kodi::GetSettingInt("fallspeed")) * .01;
@@ -150,17 +299,32 @@ CVisualizationMatrix::CVisualizationMatrix()
   m_dotColor.red = static_cast<float>(kodi::GetSettingInt("red")) / 255.f;
   m_dotColor.green = static_cast<float>(kodi::GetSettingInt("green")) / 255.f;
   m_dotColor.blue = static_cast<float>(kodi::GetSettingInt("blue")) / 255.f;
-  m_lowpower = kodi::GetSettingBoolean("lowpower");
-  m_noiseFluctuation = m_lowpower ? (static_cast<float>(kodi::GetSettingInt("noisefluctuation")) * 0.0002f)/m_fallSpeed * 0.25f : (static_cast<float>(kodi::GetSettingInt("noisefluctuation")) * 0.0004f)/m_fallSpeed * 0.25f;
+  SetLowpower(kodi::GetSettingBoolean("lowpower"));
+  m_cellPass = kodi::GetSettingBoolean("cellpass");
+  m_hybrid = kodi::GetSettingBoolean("hybrid");
+  m_checkerboardMode = kodi::GetSettingBoolean("checkerboard") ? CHECKERBOARD_TEMPORAL : CHECKERBOARD_OFF;
+  m_variableRateShading = kodi::GetSettingBoolean("variablerate");
+  m_compressAlbums = kodi::GetSettingBoolean("compressalbums");
   m_lastAlbumChange = 0.0;
+  m_governor.SetBudget(kodi::GetSettingInt("analysisbudget"));
+  m_framesInFlight = kodi::GetSettingInt("framesinflight");
+
+  // Half of the album memory is for the cache, the rest for the cover on
+  // screen and the one being uploaded, see SetAlbumImage()
+  m_memory.SetBudget(static_cast<size_t>(kodi::GetSettingInt("memorybudget")) * 1024 * 1024);
+  m_albumCache.SetBudget(std::min<size_t>(ALBUM_CACHE_BUDGET, m_memory.Share(CMemoryBudget::ALBUMS) / 2));
+}
+
+void CVisualizationMatrix::SetLowpower(bool lowpower)
+{
+  m_lowpower = lowpower;
+  m_noiseFluctuation = m_lowpower ? (static_cast<float>(kodi::GetSettingInt("noisefluctuation")) * 0.0002f)/m_fallSpeed * 0.25f : (static_cast<float>(kodi::GetSettingInt("noisefluctuation")) * 0.0004f)/m_fallSpeed * 0.25f;
 }
 
 CVisualizationMatrix::~CVisualizationMatrix()
 {
-  delete [] m_audioData;
-  delete [] m_magnitudeBuffer;
-  delete [] m_pcm;
-  free(m_kissCfg);
+  ReleaseGLResources();
+
 }
 
 //-- Render -------------------------------------------------------------------
@@ -170,81 +334,829 @@ void CVisualizationMatrix::Render()
 {
   if (m_initialized)
   {
-    RenderTo(m_matrixShader.ProgramHandle(), 0);
+    auto now = std::chrono::high_resolution_clock::now();
+    if (m_lastFrame.time_since_epoch().count())
+    {
+      double interval = std::chrono::duration<double, std::milli>(now - m_lastFrame).count();
+      m_frameInterval.Add(interval);
+      m_albumUploader.FrameTime(interval);
+    }
+    m_lastFrame = now;
+
+    if (std::chrono::duration<double>(now - m_lastStatistics).count() >= STATISTICS_INTERVAL)
+    {
+      if (m_lastStatistics.time_since_epoch().count())
+        LogStatistics();
+      m_lastStatistics = now;
+    }
+
+    // Wait before the audio texture is updated, so the newest analysis
+    // result ends up in the frame
+    WaitForFrameSlot();
+
+    UpdateAlbumTexture();
+
+    if (m_replay)
+    {
+      m_replay->Render();
+      if (m_replay->Seconds() >= REPLAY_TIME)
+        FinishReplay(true);
+    }
+    else
+    {
+      if (m_benchmark.active)
+        BenchmarkFrame();
+      else if (m_autotune.active)
+        AutotuneFrame();
+      RenderTo(m_matrixShader->ProgramHandle(), 0);
+    }
+#if defined(HAS_GL_SYNC)
+    if (m_framesInFlight)
+      m_frameFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+#endif
+    m_deletionQueue.EndFrame();
   }
 }
 
+void CVisualizationMatrix::WaitForFrameSlot()
+{
+#if defined(HAS_GL_SYNC)
+  // Without a limit the driver may queue several frames, each one adds a
+  // frame of delay between the audio and the picture
+  while (!m_frameFences.empty() && m_frameFences.size() >= static_cast<size_t>(m_framesInFlight))
+  {
+    GLsync fence = m_frameFences.front();
+    m_frameFences.pop_front();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_FENCE_TIMEOUT);
+    if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+      kodi::Log(ADDON_LOG_DEBUG, "Frame fence wait timed out");
+    glDeleteSync(fence);
+    m_fenceWait.Add(std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+  }
+#endif
+}
+
 bool CVisualizationMatrix::Start(int iChannels, int iSamplesPerSec, int iBitsPerSample, std::string szSongName)
 {
   kodi::Log(ADDON_LOG_DEBUG, "Start %i %i %i %s\n", iChannels, iSamplesPerSec, iBitsPerSample, szSongName.c_str());
 
-  //background vertex
-  static const GLfloat vertex_data[] =
   {
-    -1.0, 1.0, 1.0, 1.0,
-     1.0, 1.0, 1.0, 1.0,
-     1.0,-1.0, 1.0, 1.0,
-    -1.0,-1.0, 1.0, 1.0,
-  };
-
-  // Upload vertex data to a buffer
-  glGenBuffers(1, &m_state.vertex_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, m_state.vertex_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_data), vertex_data, GL_STATIC_DRAW);
-
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_startChannels.Add(iChannels);
+    m_startSampleRates.Add(iSamplesPerSec);
+    if (m_samplesPerSec && m_samplesPerSec != iSamplesPerSec)
+      m_sampleRateChanges++;
+  }
   m_samplesPerSec = iSamplesPerSec;
-  Launch(m_currentPreset);
+
+  ResumeGLResources();
   m_initialized = true;
 
+  if (kodi::GetSettingBoolean("runbenchmark"))
+  {
+    kodi::SetSettingBoolean("runbenchmark", false);
+    StartBenchmark();
+  }
+  if (kodi::GetSettingBoolean("captureframe"))
+  {
+    kodi::SetSettingBoolean("captureframe", false);
+    m_capturePending = true;
+  }
+  if (kodi::GetSettingBoolean("replaycapture"))
+  {
+    kodi::SetSettingBoolean("replaycapture", false);
+    StartReplay();
+  }
+
   return true;
 }
 
+void CVisualizationMatrix::ResumeGLResources()
+{
+  // Kodi stops and starts the visualization when the fullscreen view is left
+  // and entered again. The GPU resources are kept in between and only rebuilt
+  // if the GL context was really destroyed.
+  if (m_glResources && !GLResourcesAlive())
+  {
+    kodi::Log(ADDON_LOG_INFO, "GL context was recreated, rebuilding resources");
+    ForgetGLResources();
+  }
+
+  if (!m_glResources)
+  {
+    // Upload vertex data to a buffer
+    glGenBuffers(1, &m_state.vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_state.vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertexData), g_vertexData, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_glResources = true;
+
+    Launch(m_currentPreset);
+  }
+  else if (m_state.fbwidth != Width() || m_state.fbheight != Height())
+  {
+    // Resolution is baked into the shader
+    Launch(m_currentPreset);
+  }
+}
+
 void CVisualizationMatrix::Stop()
 {
   m_initialized = false;
   kodi::Log(ADDON_LOG_DEBUG, "Stop");
+  AbortBenchmark(true);
+  FinishReplay(false);
+  LogStatistics();
+  m_lastFrame = std::chrono::high_resolution_clock::time_point();
+}
+
+void CVisualizationMatrix::StartBenchmark()
+{
+  kodi::Log(ADDON_LOG_INFO, "Benchmark started at %ix%i", Width(), Height());
+
+  m_benchmark.active = true;
+  m_benchmark.preset = 0;
+  m_benchmark.tier = 0;
+  m_benchmark.savedPreset = m_currentPreset;
+  m_benchmark.savedLowpower = m_lowpower;
+  m_benchmark.savedCellPass = m_cellPass;
+  m_benchmark.savedHybrid = m_hybrid;
+  m_benchmark.savedCheckerboard = m_checkerboardMode;
+  m_benchmark.savedVariableRate = m_variableRateShading;
+  m_benchmark.results.clear();
+  m_benchmark.scenario = -1;
+  m_benchmark.scenarioResults.clear();
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_analysisTime.Reset();
+  }
+  BenchmarkLaunch();
+}
+
+void CVisualizationMatrix::BenchmarkLaunch()
+{
+  // The preset under test is also what is shown, so the screen keeps running
+  SetLowpower(g_benchmarkTiers[m_benchmark.tier].lowpower);
+  m_cellPass = g_benchmarkTiers[m_benchmark.tier].cellPass;
+  m_hybrid = g_benchmarkTiers[m_benchmark.tier].hybrid;
+  m_checkerboardMode = g_benchmarkTiers[m_benchmark.tier].checkerboard;
+  m_variableRateShading = g_benchmarkTiers[m_benchmark.tier].variableRate;
+  m_currentPreset = m_benchmark.preset;
+  Launch(m_currentPreset);
+  UpdateAlbumart();
+
+  // Golden image: the tiers which drop pixels are compared to the normal
+  // tier at the same time
+  m_benchmark.difference = -1.0;
+  if (m_state.effect_fb && m_benchmark.tier == 0)
+    m_benchmark.reference = RenderStill();
+  else if (m_state.effect_fb && (m_checkerboardActive || m_variableRateActive) && !m_benchmark.reference.empty())
+    m_benchmark.difference = ImageDifference(RenderStill(), m_benchmark.reference);
+
+  m_benchmark.frames = 0;
+  m_benchmark.cpuTime = 0.0;
+  m_benchmark.gpuTimes.clear();
+  m_benchmark.start = std::chrono::high_resolution_clock::now();
+}
+
+void CVisualizationMatrix::BenchmarkFrame()
+{
+  if (m_benchmark.scenario >= 0)
+  {
+    ScenarioFrame();
+    return;
+  }
+
+  // One offscreen frame through the effect framebuffer per visible frame
+  CGPUTimer timer;
+  auto start = std::chrono::high_resolution_clock::now();
+  timer.Begin();
+  RenderTo(m_matrixShader->ProgramHandle(), m_state.effect_fb);
+  auto submitted = std::chrono::high_resolution_clock::now();
+  m_benchmark.gpuTimes.push_back(timer.End());
+  m_benchmark.cpuTime += std::chrono::duration<double, std::milli>(submitted - start).count();
+  m_benchmark.frames++;
+
+  if (std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_benchmark.start).count() < BENCHMARK_TIME)
+    return;
+
+  BenchmarkResult result;
+  result.preset = m_benchmark.preset;
+  result.tier = m_benchmark.tier;
+  result.frames = m_benchmark.frames;
+  result.cpuTime = m_benchmark.cpuTime / m_benchmark.frames;
+  std::sort(m_benchmark.gpuTimes.begin(), m_benchmark.gpuTimes.end());
+  double sum = 0.0;
+  for (double time : m_benchmark.gpuTimes)
+    sum += time;
+  result.gpuTime = sum / m_benchmark.frames;
+  result.gpuTime95 = m_benchmark.gpuTimes[m_benchmark.gpuTimes.size() * 95 / 100];
+  result.gpuTimeMax = m_benchmark.gpuTimes.back();
+  result.difference = m_benchmark.difference;
+  result.shaded = m_checkerboardActive ? 0.5f : m_variableRateActive ? m_variableRate.Shaded() : 1.0f;
+  m_benchmark.results.push_back(result);
+
+  if (++m_benchmark.tier >= static_cast<int>(g_benchmarkTiers.size()))
+  {
+    m_benchmark.tier = 0;
+    m_benchmark.preset++;
+  }
+
+  if (m_benchmark.preset < static_cast<int>(g_presets.size()))
+  {
+    BenchmarkLaunch();
+  }
+  else
+  {
+    m_benchmark.scenario = 0;
+    ScenarioLaunch();
+  }
+}
+
+void CVisualizationMatrix::ScenarioLaunch()
+{
+  // The album storm needs a preset that shows the cover
+  SetLowpower(g_benchmarkTiers[0].lowpower);
+  m_cellPass = g_benchmarkTiers[0].cellPass;
+  m_hybrid = g_benchmarkTiers[0].hybrid;
+  m_checkerboardMode = g_benchmarkTiers[0].checkerboard;
+  m_variableRateShading = g_benchmarkTiers[0].variableRate;
+  m_currentPreset = 0;
+  if (g_benchmarkScenarios[m_benchmark.scenario].action == SCENARIO_ALBUM)
+  {
+    for (size_t i = 0; i < g_presets.size(); i++)
+    {
+      if (g_presets[i].channel[3] == 2)
+      {
+        m_currentPreset = i;
+        break;
+      }
+    }
+  }
+  Launch(m_currentPreset);
+  UpdateAlbumart();
+
+  m_benchmark.actions = 0;
+  m_benchmark.intervals.clear();
+  m_benchmark.memory = m_memory.Used();
+  m_benchmark.resident = CDeviceProfile::ResidentMemory();
+  m_benchmark.start = std::chrono::high_resolution_clock::now();
+  m_benchmark.lastFrame = m_benchmark.start;
+  m_benchmark.lastAction = m_benchmark.start;
+}
+
+void CVisualizationMatrix::ScenarioFrame()
+{
+  // Measures the visible frames, the action runs in the Render() call of the
+  // frame so its cost shows up in the next interval
+  const BenchmarkScenario& scenario = g_benchmarkScenarios[m_benchmark.scenario];
+  auto now = std::chrono::high_resolution_clock::now();
+  m_benchmark.intervals.push_back(std::chrono::duration<double, std::milli>(now - m_benchmark.lastFrame).count());
+  m_benchmark.lastFrame = now;
+
+  if (std::chrono::duration<double>(now - m_benchmark.start).count() < SCENARIO_TIME)
+  {
+    if (std::chrono::duration<double>(now - m_benchmark.lastAction).count() >= scenario.interval)
+    {
+      ScenarioAction();
+      m_benchmark.actions++;
+      m_benchmark.lastAction = std::chrono::high_resolution_clock::now();
+    }
+    return;
+  }
+
+  ScenarioResult result;
+  result.scenario = m_benchmark.scenario;
+  result.actions = m_benchmark.actions;
+  result.frames = m_benchmark.intervals.size();
+  std::vector<double> sorted = m_benchmark.intervals;
+  std::sort(sorted.begin(), sorted.end());
+  const double median = sorted[sorted.size() / 2];
+  result.worstFrame = sorted.back();
+  result.stalls = 0;
+  for (double interval : m_benchmark.intervals)
+  {
+    if (interval > median * SCENARIO_STALL_FACTOR)
+      result.stalls++;
+  }
+  // Growth is taken once the scenario is over, whatever wasn't given back by
+  // then is likely to pile up with longer use
+  result.memoryGrowth = static_cast<long long>(m_memory.Used()) - static_cast<long long>(m_benchmark.memory);
+  const size_t resident = CDeviceProfile::ResidentMemory();
+  result.residentGrowth = resident && m_benchmark.resident ? static_cast<long long>(resident) - static_cast<long long>(m_benchmark.resident) : 0;
+  m_benchmark.scenarioResults.push_back(result);
+
+  if (++m_benchmark.scenario < static_cast<int>(g_benchmarkScenarios.size()))
+    ScenarioLaunch();
+  else
+    FinishBenchmark();
+}
+
+void CVisualizationMatrix::ScenarioAction()
+{
+  switch (g_benchmarkScenarios[m_benchmark.scenario].action)
+  {
+    case SCENARIO_NEXT_PRESET:
+      m_currentPreset = (m_currentPreset + 1) % g_presets.size();
+      Launch(m_currentPreset);
+      UpdateAlbumart();
+      break;
+    case SCENARIO_RANDOM_PRESET:
+      m_currentPreset = (int)((std::rand() / (float)RAND_MAX) * g_presets.size()) % g_presets.size();
+      Launch(m_currentPreset);
+      UpdateAlbumart();
+      break;
+    case SCENARIO_ALBUM:
+      // Alternating covers, the larger one needs the full upload path
+      SetAlbumImage(kodi::GetAddonPath(m_benchmark.actions % 2 ? "resources/icon.jpg" : "resources/fanart.jpg"));
+      break;
+    case SCENARIO_RESIZE:
+      // The window can't be resized from here, this is what Start() does
+      // when the size changed
+      Launch(m_currentPreset);
+      UpdateAlbumart();
+      break;
+    case SCENARIO_STOP_START:
+      // Same as Stop() and Start() without ending the benchmark
+      LogStatistics();
+      m_lastFrame = std::chrono::high_resolution_clock::time_point();
+      ResumeGLResources();
+      UpdateAlbumart();
+      break;
+  }
+}
+
+void CVisualizationMatrix::FinishBenchmark()
+{
+  const std::string renderer = RendererName();
+  const std::string resolution = std::to_string(Width()) + "x" + std::to_string(Height());
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+  std::string report;
+  report += "Matrix visualization benchmark\n";
+  report += "Renderer: " + renderer + "\n";
+  report += "Version: " + std::string(version ? version : "unknown") + "\n";
+  report += "CPU: " + CDeviceProfile::CPUModel() + "\n";
+  report += "Resolution: " + resolution + "\n";
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    report += "Audio analysis (us): " + m_analysisTime.ToString() + "\n";
+  }
+  // Audio and render thread on different cores, with and without the fields
+  // of each side on their own cache lines
+  double isolatedNs, packedNs;
+  CAnalysisState::MeasureContention(CONTENTION_TIME, isolatedNs, packedNs);
+  char contention[128];
+  snprintf(contention, sizeof(contention), "Analysis state update (ns): %.1f isolated, %.1f packed\n", isolatedNs, packedNs);
+  report += contention;
+  report += "\npreset;tier;frames;cpu ms;gpu ms;gpu 95% ms;gpu max ms;difference;shaded\n";
+
+  // Pre-populate the device profile, a tier is recommended if the normal one
+  // can't keep 60 fps for most presets
+  const double frameBudget = 1000.0 / 60.0;
+  std::vector<int> overBudget(g_benchmarkTiers.size(), 0);
+  for (const auto& result : m_benchmark.results)
+  {
+    const std::string& file = g_presets[result.preset].file;
+    const std::string& tier = g_benchmarkTiers[result.tier].name;
+
+    char difference[32] = "-";
+    if (result.difference >= 0.0)
+      snprintf(difference, sizeof(difference), "%.3f", result.difference);
+    char line[256];
+    snprintf(line, sizeof(line), "%s;%s;%i;%.3f;%.3f;%.3f;%.3f;%s;%.2f\n", file.c_str(), tier.c_str(), result.frames,
+             result.cpuTime, result.gpuTime, result.gpuTime95, result.gpuTimeMax, difference, result.shaded);
+    report += line;
+
+    m_profile.Set("benchmark." + renderer + "." + resolution + "." + file + "." + tier, std::to_string(result.gpuTime));
+    if (result.gpuTime > frameBudget)
+      overBudget[result.tier]++;
+  }
+  bool lowpower = overBudget[0] > static_cast<int>(g_presets.size()) / 2;
+  m_profile.Set("lowpower.recommended." + renderer + "." + resolution, lowpower ? "true" : "false");
+  m_profile.Save();
+
+  // Savings of the coarse edges per preset, against the normal tier
+  report += "\npreset;variable rate shaded;gpu ms saved\n";
+  for (const auto& result : m_benchmark.results)
+  {
+    if (!g_benchmarkTiers[result.tier].variableRate)
+      continue;
+    for (const auto& normal : m_benchmark.results)
+    {
+      if (normal.preset != result.preset || normal.tier != 0)
+        continue;
+      char line[256];
+      snprintf(line, sizeof(line), "%s;%.2f;%.3f\n", g_presets[result.preset].file.c_str(), result.shaded,
+               normal.gpuTime - result.gpuTime);
+      report += line;
+    }
+  }
+
+  report += "\nscenario;actions;frames;worst ms;stalls;memory growth KiB;resident growth KiB\n";
+  for (const auto& result : m_benchmark.scenarioResults)
+  {
+    char line[256];
+    snprintf(line, sizeof(line), "%s;%i;%i;%.3f;%i;%lli;%lli\n", g_benchmarkScenarios[result.scenario].name.c_str(),
+             result.actions, result.frames, result.worstFrame, result.stalls, result.memoryGrowth / 1024,
+             result.residentGrowth / 1024);
+    report += line;
+  }
+
+  std::string file = kodi::GetBaseUserPath("benchmark.txt");
+  kodi::vfs::CFile output;
+  if (output.OpenFileForWrite(file, true))
+  {
+    output.Write(report.c_str(), report.size());
+    output.Close();
+    kodi::Log(ADDON_LOG_INFO, "Benchmark finished, report written to %s", file.c_str());
+  }
+  else
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to write benchmark report %s", file.c_str());
+  }
+
+  AbortBenchmark(true);
+}
+
+void CVisualizationMatrix::AbortBenchmark(bool relaunch)
+{
+  if (!m_benchmark.active)
+    return;
+
+  m_benchmark.active = false;
+  SetLowpower(m_benchmark.savedLowpower);
+  m_cellPass = m_benchmark.savedCellPass;
+  m_hybrid = m_benchmark.savedHybrid;
+  m_checkerboardMode = m_benchmark.savedCheckerboard;
+  m_variableRateShading = m_benchmark.savedVariableRate;
+  m_benchmark.reference.clear();
+  m_currentPreset = m_benchmark.savedPreset;
+  if (relaunch && m_glResources)
+  {
+    Launch(m_currentPreset);
+    UpdateAlbumart();
+  }
+}
+
+void CVisualizationMatrix::CaptureFrame()
+{
+  m_capturePending = false;
+
+  // The replay draws the whole frame with the main program
+  if (m_checkerboardActive)
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Frame capture is not supported with checkerboard rendering");
+    return;
+  }
+
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  CFrameCapture capture;
+  capture.renderer = RendererName();
+  capture.version = version ? version : "unknown";
+  capture.preset = g_presets[m_currentPreset].file;
+  capture.width = m_state.fbwidth ? m_state.fbwidth : Width();
+  capture.height = m_state.fbheight ? m_state.fbheight : Height();
+  capture.main = m_matrixSources;
+  CFrameCapture::ReadUniforms(m_matrixShader->ProgramHandle(), capture.main.uniforms);
+  if (m_cellPassActive)
+  {
+    capture.cells = m_cellSources;
+    CFrameCapture::ReadUniforms(m_cellShader->ProgramHandle(), capture.cells.uniforms);
+    capture.cellWidth = m_cellWidth;
+    capture.cellHeight = m_cellHeight;
+  }
+
+  // The textures as bound by RenderTo(). GLES can't read textures back, so
+  // the images are loaded again from their files, the album as plain RGBA
+  // and the logo as its distance field.
+  for (int i = 0; i < 4; i++)
+  {
+    if (m_shaderTextures[i].audio)
+    {
+      capture.textures.push_back({i, NUM_BANDS, 2, 1, GL_LINEAR, GL_CLAMP_TO_EDGE,
+                                  std::vector<uint8_t>(m_analysis.Rows(), m_analysis.Rows() + NUM_BANDS * 2)});
+      continue;
+    }
+    if (!m_channelTextures[i])
+      continue;
+
+    bool album = i == 3 && g_presets[m_currentPreset].channel[3] == 2 && !m_albumFile.empty();
+    CImage image;
+    if (album)
+      image.Load(m_albumFile);
+    else
+      image = LoadChannelImage(i);
+    const size_t maxPixels = album ? AlbumMaxPixels() : 0;
+    while (maxPixels && static_cast<size_t>(image.Width()) * image.Height() > maxPixels &&
+           image.Width() > 1 && image.Height() > 1)
+      image = image.Downscale(2);
+    if (image.Empty())
+      continue;
+    if (i == CCellRenderer::CHANNEL_LOGO)
+    {
+      capture.textures.push_back({i, image.Width(), image.Height(), 1, GL_LINEAR, GL_CLAMP_TO_EDGE, image.Channel(0)});
+      continue;
+    }
+    capture.textures.push_back({i, image.Width(), image.Height(), 4, GL_LINEAR, i == 2 ? GL_REPEAT : GL_CLAMP_TO_EDGE,
+                                std::vector<uint8_t>(image.Data(), image.Data() + image.Width() * image.Height() * 4)});
+  }
+  if (m_shaderVariant & SHADER_VARIANT_DOT_LUT)
+    capture.textures.push_back({4, DOT_LUT_SIZE, DOT_LUT_SIZE, 4, GL_LINEAR, GL_REPEAT, DotLUT()});
+  if (m_hybridActive && !m_capturedCells.empty())
+    capture.textures.push_back({5, m_cellWidth, m_cellHeight, 1, GL_LINEAR, GL_CLAMP_TO_EDGE, m_capturedCells});
+  m_capturedCells.clear();
+
+  std::string file = kodi::GetBaseUserPath("frame.capture");
+  if (capture.Save(file))
+    kodi::Log(ADDON_LOG_INFO, "Frame of %s captured to %s", capture.preset.c_str(), file.c_str());
+  else
+    kodi::Log(ADDON_LOG_ERROR, "Failed to write frame capture %s", file.c_str());
+}
+
+void CVisualizationMatrix::StartReplay()
+{
+  CFrameCapture capture;
+  if (!capture.Load(kodi::GetBaseUserPath("frame.capture")))
+    return;
+
+  AbortBenchmark(true);
+  m_replay.reset(new CFrameReplay(m_deletionQueue));
+  if (!m_replay->Start(capture, kodi::GetBaseUserPath("replay/"), m_state.vertex_buffer))
+    m_replay.reset();
+}
+
+void CVisualizationMatrix::FinishReplay(bool report)
+{
+  if (!m_replay)
+    return;
+
+  if (report)
+  {
+    std::string file = kodi::GetBaseUserPath("replay.txt");
+    std::string text = m_replay->Report();
+    kodi::vfs::CFile output;
+    if (output.OpenFileForWrite(file, true))
+    {
+      output.Write(text.c_str(), text.size());
+      output.Close();
+      kodi::Log(ADDON_LOG_INFO, "Frame replay finished, report written to %s", file.c_str());
+    }
+    else
+    {
+      kodi::Log(ADDON_LOG_ERROR, "Failed to write frame replay report %s", file.c_str());
+    }
+  }
+  m_replay.reset();
+}
+
+void CVisualizationMatrix::LogStatistics()
+{
+  // How Kodi calls AudioData differs by audio sink and sample rate, all
+  // analysis tuning (hop size, threads, sliding DFT) depends on it
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: AudioData interval (ms) %s", m_audioInterval.ToString().c_str());
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: AudioData length (samples) %s", m_audioLength.ToString().c_str());
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: analysis time (us) %s, tier %i", m_analysisTime.ToString().c_str(), m_governor.ActiveTier());
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: audio updates %u published, %u taken, %u skipped as unchanged, %u partial, %u full uploads",
+            m_analysis.Published(), m_analysis.Acquired(), m_audioRows.Skipped(), m_audioRows.Partial(), m_audioRows.Full());
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: audio upload %u of %u KiB",
+            static_cast<unsigned int>(m_audioRows.UploadedBytes() / 1024), static_cast<unsigned int>(m_audioRows.OfferedBytes() / 1024));
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: channels at start %s, sample rates at start %s, %u changes",
+            m_startChannels.ToString().c_str(), m_startSampleRates.ToString().c_str(), m_sampleRateChanges);
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: frame interval (ms) %s", m_frameInterval.ToString().c_str());
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: frame fence wait (us) %s", m_fenceWait.ToString().c_str());
+
+  // Compression time against cache loads is what the disk cache saves,
+  // the LRU saves both plus the upload
+  double savedMs = 0.0;
+  if (m_albumsCompressed && m_albumsFromDisk)
+    savedMs = (m_albumCompressMs / m_albumsCompressed - m_albumDiskMs / m_albumsFromDisk) * m_albumsFromDisk;
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: album textures %s, %u compressed in %.1f ms, %u from disk in %.1f ms (%.0f ms saved), %u reused",
+            CTextureCompressor::FormatName(m_albumFormat), m_albumsCompressed, m_albumCompressMs,
+            m_albumsFromDisk, m_albumDiskMs, savedMs, m_albumCache.Hits());
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: album cache %u covers in %u KiB, %u KiB less than RGBA",
+            static_cast<unsigned int>(m_albumCache.Count()), static_cast<unsigned int>(m_albumCache.Bytes() / 1024),
+            static_cast<unsigned int>(m_albumCache.SavedBytes() / 1024));
+
+  UpdateAlbumMemory();
+  kodi::Log(ADDON_LOG_DEBUG, "Statistics: memory %s", m_memory.ToString().c_str());
+
+  m_audioInterval.Reset();
+  m_audioLength.Reset();
+  m_analysisTime.Reset();
+  m_frameInterval.Reset();
+  m_fenceWait.Reset();
+}
+
+bool CVisualizationMatrix::GLResourcesAlive()
+{
+  // Object names are reused by a new context, so besides the names also check
+  // that they still look like the objects created here
+  if (!glIsBuffer(m_state.vertex_buffer) || !glIsProgram(m_matrixShader->ProgramHandle()))
+    return false;
+
+  GLint size = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, m_state.vertex_buffer);
+  glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  if (size != sizeof(g_vertexData))
+    return false;
+
+  if (glGetUniformLocation(m_matrixShader->ProgramHandle(), "iTime") != m_attrGlobalTimeLoc)
+    return false;
+
+  for (int i = 0; i < 4; i++)
+  {
+    if (m_channelTextures[i] && !glIsTexture(m_channelTextures[i]))
+      return false;
+  }
+  for (int i = 0; i < AUDIO_TEXTURE_RING; i++)
+  {
+    if (m_audioTextures[i] && !glIsTexture(m_audioTextures[i]))
+      return false;
+  }
+
+  return true;
+}
+
+void CVisualizationMatrix::ReleaseGLResources()
+{
+  if (!m_glResources)
+    return;
 
   UnloadPreset();
   UnloadTextures();
+  m_albumCache.Clear();
+
+  m_deletionQueue.DeleteTexture(m_dotLUTTexture);
+  m_dotLUTTexture = 0;
+  m_deletionQueue.DeleteBuffer(m_state.vertex_buffer);
+  m_state.vertex_buffer = 0;
 
-  glDeleteBuffers(1, &m_state.vertex_buffer);
+#if defined(HAS_GL_SYNC)
+  for (auto fence : m_frameFences)
+    glDeleteSync(fence);
+  m_frameFences.clear();
+#endif
+
+  // Nothing is rendered anymore, no need to wait
+  m_deletionQueue.Flush();
+  m_bitsPrecision = 0;
+  m_glResources = false;
 }
 
+void CVisualizationMatrix::ForgetGLResources()
+{
+  // The objects died with their context, deleting the names now could hit
+  // objects of the new context. The shader program object would delete its
+  // names on destruction, so it is intentionally leaked.
+  m_matrixShader.release();
+  m_matrixShader.reset(new kodi::gui::gl::CShaderProgram);
+  m_albumUploader.Forget();
+  m_albumCache.Forget();
+  m_checkerboard.Forget();
+  m_variableRate.Forget();
+  if (m_replay)
+    m_replay->Forget();
+  m_replay.reset();
+  m_cellShader.release();
+  m_cellShader.reset(new kodi::gui::gl::CShaderProgram);
+  m_deletionQueue.Forget();
+#if defined(HAS_GL_SYNC)
+  m_frameFences.clear();
+#endif
+
+  m_state.vertex_buffer = 0;
+  m_state.effect_fb = 0;
+  m_state.framebuffer_texture = 0;
+  m_cellFB = 0;
+  m_cellTexture = 0;
+  for (int i = 0; i < AUDIO_TEXTURE_RING; i++)
+    m_hybridTextures[i] = 0;
+  for (int i = 0; i < 4; i++)
+    m_channelTextures[i] = 0;
+  for (int i = 0; i < AUDIO_TEXTURE_RING; i++)
+    m_audioTextures[i] = 0;
+  m_dotLUTTexture = 0;
+  m_albumTextureOwned = true;
+  m_albumTextureBytes = 0;
+  for (auto category : {CMemoryBudget::TEXTURES, CMemoryBudget::ALBUMS, CMemoryBudget::FRAMEBUFFERS, CMemoryBudget::SHADERS})
+    m_memory.SetUsed(category, 0);
+  m_bitsPrecision = 0;
+  m_albumFormat = 0;
+  m_glResources = false;
+}
 
 void CVisualizationMatrix::AudioData(const float* pAudioData, int iAudioDataLength, float* pFreqData, int iFreqDataLength)
 {
-  WriteToBuffer(pAudioData, iAudioDataLength, 2);
+  auto start = std::chrono::high_resolution_clock::now();
 
-  kiss_fft_cpx in[AUDIO_BUFFER], out[AUDIO_BUFFER];
-  for (unsigned int i = 0; i < AUDIO_BUFFER; i++)
   {
-    in[i].r = BlackmanWindow(m_pcm[i], i, AUDIO_BUFFER);
-    in[i].i = 0;
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    if (m_lastAudioData.time_since_epoch().count())
+      m_audioInterval.Add(std::chrono::duration<double, std::milli>(start - m_lastAudioData).count());
+    m_audioLength.Add(iAudioDataLength);
   }
+  m_lastAudioData = start;
 
-  kiss_fft(m_kissCfg, in, out);
+  const int tierIndex = m_governor.ActiveTier();
+  const AnalysisTier& tier = g_analysisTiers[tierIndex];
+  WriteToBuffer(pAudioData, iAudioDataLength, 2, tier.stereo ? 2 : 1);
+
+  if (!m_governor.NextCallback())
+    return;
+
+  // Window the most recent fftSize samples
+  const unsigned int fftSize = tier.fftSize;
+  const unsigned int offset = AUDIO_BUFFER - fftSize;
+  const float* pcm = m_analysis.Pcm();
+  float in[AUDIO_BUFFER];
+  kiss_fft_cpx out[AUDIO_BUFFER];
+  for (unsigned int i = 0; i < fftSize; i++)
+  {
+    in[i] = BlackmanWindow(pcm[offset + i], i, fftSize);
+  }
+
+  m_fftEngines[tierIndex]->Transform(in, out);
 
   out[0].i = 0;
 
-  SmoothingOverTime(m_magnitudeBuffer, m_magnitudeBuffer, out, NUM_BANDS, SMOOTHING_TIME_CONSTANT, AUDIO_BUFFER);
+  // Spread smaller transforms over all bands, walking backwards so the
+  // source bins are not overwritten before they are read
+  if (fftSize < AUDIO_BUFFER)
+  {
+    for (int i = NUM_BANDS - 1; i > 0; i--)
+      out[i] = out[i * fftSize / AUDIO_BUFFER];
+  }
+
+  // Keep the smoothing constant in time when callbacks are skipped
+  float smoothing = static_cast<float>(pow(SMOOTHING_TIME_CONSTANT, tier.hop));
+  float* magnitudes = m_analysis.Magnitudes();
+  SmoothingOverTime(magnitudes, magnitudes, out, NUM_BANDS, smoothing, fftSize);
 
+  GLubyte* rows = m_analysis.WriteRows();
   const double rangeScaleFactor = MAX_DECIBELS == MIN_DECIBELS ? 1 : (1.0 / (MAX_DECIBELS - MIN_DECIBELS));
   for (unsigned int i = 0; i < NUM_BANDS; i++)
   {
-    float linearValue = m_magnitudeBuffer[i];
+    float linearValue = magnitudes[i];
     double dbMag = !linearValue ? MIN_DECIBELS : LinearToDecibels(linearValue);
     double scaledValue = UCHAR_MAX * (dbMag - MIN_DECIBELS) * rangeScaleFactor;
 
-    m_audioData[i] = std::max(std::min((int)scaledValue, UCHAR_MAX), 0);
+    rows[i] = std::max(std::min((int)scaledValue, UCHAR_MAX), 0);
   }
 
   for (unsigned int i = 0; i < NUM_BANDS; i++)
   {
-    float v = (m_pcm[i] + 1.0f) * 128.0f;
-    m_audioData[i + NUM_BANDS] = std::max(std::min((int)v, UCHAR_MAX), 0);
+    float v = (pcm[i] + 1.0f) * 128.0f;
+    rows[i + NUM_BANDS] = std::max(std::min((int)v, UCHAR_MAX), 0);
+  }
+
+  m_analysis.Publish();
+
+  double elapsed = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_analysisTime.Add(elapsed);
+  }
+  if (m_governor.Measure(elapsed))
+  {
+    const AnalysisTier& active = m_governor.Tier();
+    kodi::Log(ADDON_LOG_INFO, "Analysis tier %i active (fft %u, hop %u, %s), budget %u us",
+              m_governor.ActiveTier(), active.fftSize, active.hop, active.stereo ? "stereo" : "mono", m_governor.Budget());
+  }
+}
+
+void CVisualizationMatrix::SetupFFTEngines(bool retune)
+{
+  // The fastest engine depends on the CPU, so the result of the autotuner is
+  // kept per CPU model and size like FFTW wisdom
+  const std::string cpu = CDeviceProfile::CPUModel();
+  std::vector<unsigned int> tuned;
+
+  m_fftEngines.clear();
+  for (auto tier : g_analysisTiers)
+  {
+    const std::string key = "fft." + cpu + "." + std::to_string(tier.fftSize);
+    bool done = std::find(tuned.begin(), tuned.end(), tier.fftSize) != tuned.end();
+    if (!done && (retune || !m_profile.Has(key)))
+    {
+      m_profile.Set(key, CFFTAutotuner::Tune(tier.fftSize));
+      tuned.push_back(tier.fftSize);
+      kodi::Log(ADDON_LOG_INFO, "FFT autotuner: using %s for size %u on %s", m_profile.Get(key).c_str(), tier.fftSize, cpu.c_str());
+    }
+    m_fftEngines.push_back(CFFTAutotuner::Create(m_profile.Get(key), tier.fftSize));
   }
 
-  m_needsUpload = true;
+  if (!tuned.empty())
+    m_profile.Save();
+
+  size_t analysis = m_analysis.Bytes();
+  for (const auto& engine : m_fftEngines)
+    analysis += engine->Size() * sizeof(kiss_fft_cpx) * 2;
+  m_memory.SetUsed(CMemoryBudget::ANALYSIS, analysis);
 }
 
 //-- OnAction -----------------------------------------------------------------
@@ -252,6 +1164,7 @@ void CVisualizationMatrix::AudioData(const float* pAudioData, int iAudioDataLeng
 //-----------------------------------------------------------------------------
 bool CVisualizationMatrix::NextPreset()
 {
+  AbortBenchmark(false);
   m_currentPreset = (m_currentPreset + 1) % g_presets.size();
   Launch(m_currentPreset);
   UpdateAlbumart();
@@ -261,6 +1174,7 @@ bool CVisualizationMatrix::NextPreset()
 
 bool CVisualizationMatrix::PrevPreset()
 {
+  AbortBenchmark(false);
   m_currentPreset = (m_currentPreset - 1) % g_presets.size();
   Launch(m_currentPreset);
   UpdateAlbumart();
@@ -271,6 +1185,7 @@ bool CVisualizationMatrix::PrevPreset()
 bool CVisualizationMatrix::LoadPreset(int select)
 {
   kodi::Log(ADDON_LOG_DEBUG, "Loading preset %i\n",select);
+  AbortBenchmark(false);
   m_currentPreset = select % g_presets.size();
   Launch(m_currentPreset);
   UpdateAlbumart();
@@ -280,6 +1195,7 @@ bool CVisualizationMatrix::LoadPreset(int select)
 
 bool CVisualizationMatrix::RandomPreset()
 {
+  AbortBenchmark(false);
   m_currentPreset = (int)((std::rand() / (float)RAND_MAX) * g_presets.size());
   Launch(m_currentPreset);
   UpdateAlbumart();
@@ -306,49 +1222,170 @@ bool CVisualizationMatrix::GetPresets(std::vector<std::string>& presets)
 //-----------------------------------------------------------------------------
 int CVisualizationMatrix::GetActivePreset()
 {
-  return m_currentPreset;
+  return m_currentPreset;
+}
+
+bool CVisualizationMatrix::UpdateAlbumart()
+{
+  return CVisualizationMatrix::UpdateAlbumart(m_albumArt);
+}
+
+bool CVisualizationMatrix::UpdateAlbumart(std::string albumart)
+{
+  m_albumArt = albumart;
+
+  kodi::Log(ADDON_LOG_DEBUG, "Updating album art %s\n",albumart.c_str());
+  if (g_presets[m_currentPreset].channel[3] != 2)
+  {
+    return false;
+  }
+
+  std::string thumb = kodi::vfs::GetCacheThumbName(albumart.c_str());
+  thumb = thumb.substr(0,8);
+  std::string special = std::string("special://thumbnails/") + thumb.c_str()[0] + std::string("/") + thumb.c_str();
+
+  if (kodi::vfs::FileExists(special + std::string(".png")))
+  {
+    SetAlbumImage(kodi::vfs::TranslateSpecialProtocol(special + std::string(".png")));
+    return true;
+  }
+  else if (kodi::vfs::FileExists(special + std::string(".jpg")))
+  {
+    SetAlbumImage(kodi::vfs::TranslateSpecialProtocol(special + std::string(".jpg")));
+    return true;
+  }
+
+  SetAlbumImage(kodi::GetAddonPath("resources/textures/logo.png"));
+  
+  return false;
+}
+
+void CVisualizationMatrix::SetAlbumTexture(GLuint texture, size_t bytes, bool owned)
+{
+  // The previous cover may still be in use by the GPU
+  if (m_albumTextureOwned)
+    m_deletionQueue.DeleteTexture(m_channelTextures[3]);
+  m_channelTextures[3] = texture;
+  m_albumTextureOwned = owned;
+  m_albumTextureBytes = owned ? bytes : 0;
+  UpdateAlbumMemory();
+}
+
+void CVisualizationMatrix::UpdateAlbumMemory()
+{
+  size_t bytes = m_albumCache.Bytes() + m_albumTextureBytes;
+  if (m_albumUploader.Busy())
+    bytes += m_albumUploader.PlainBytes();
+  m_memory.SetUsed(CMemoryBudget::ALBUMS, bytes);
 }
 
-bool CVisualizationMatrix::UpdateAlbumart()
+void CVisualizationMatrix::SetAlbumImage(const std::string& file)
 {
-  return CVisualizationMatrix::UpdateAlbumart(m_albumArt);
+  if (!m_albumLoader)
+    m_albumLoader.reset(new CAlbumLoader(ThreadPool(), kodi::GetBaseUserPath("textures/")));
+
+  // The hybrid mode needs the pixels as well, those are not kept
+  GLuint cached = m_hybridActive ? 0 : m_albumCache.Find(file);
+  if (cached)
+  {
+    m_albumLoader->Cancel();
+    m_albumUploader.Cancel();
+    SetAlbumTexture(cached, 0, false);
+    m_albumFile = file;
+    return;
+  }
+
+  // Decoded on the thread pool, see UpdateAlbumTexture()
+  m_albumLoader->Load(file, m_albumFormat, m_hybridActive, AlbumMaxPixels());
 }
 
-bool CVisualizationMatrix::UpdateAlbumart(std::string albumart)
+size_t CVisualizationMatrix::AlbumMaxPixels() const
 {
-  m_albumArt = albumart;
+  // The cover on screen, its preview and the next one being uploaded have
+  // to fit in the other half of the album memory. Compressed textures take
+  // less than a byte per pixel with all mip levels.
+  if (!m_memory.Limited())
+    return 0;
+  return m_memory.Share(CMemoryBudget::ALBUMS) / 4 / (m_albumFormat ? 1 : 4);
+}
 
-  kodi::Log(ADDON_LOG_DEBUG, "Updating album art %s\n",albumart.c_str());
-  if (g_presets[m_currentPreset].channel[3] != 2)
+void CVisualizationMatrix::UpdateAlbumTexture()
+{
+  // A decoded cover is shown as a small preview right away, the full image
+  // replaces it once it is uploaded completely
+  CAlbumLoader::Result result;
+  if (m_albumLoader && m_albumLoader->Poll(result) && g_presets[m_currentPreset].channel[3] == 2)
   {
-    return false;
+    if (m_cellRenderer)
+      m_cellRenderer->SetImage(CCellRenderer::CHANNEL_ALBUM, result.image);
+
+    m_albumFile = result.file;
+    if (!result.texture.Empty())
+    {
+      if (result.cached)
+      {
+        m_albumsFromDisk++;
+        m_albumDiskMs += result.ms;
+      }
+      else
+      {
+        m_albumsCompressed++;
+        m_albumCompressMs += result.ms;
+      }
+      if (result.previewLevel >= 0 && result.previewLevel < static_cast<int>(result.texture.levels.size()))
+      {
+        const CTextureData::Level& level = result.texture.levels[result.previewLevel];
+        SetAlbumTexture(CreateTexture(level, result.texture.format, GL_LINEAR, GL_CLAMP_TO_EDGE), level.data.size());
+      }
+      m_albumUploader.Start(result.texture, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    }
+    else
+    {
+      if (!result.preview.Empty() || result.image.Empty())
+        SetAlbumTexture(CreateTexture(result.preview, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE),
+                        static_cast<size_t>(result.preview.Width()) * result.preview.Height() * 4);
+      m_albumUploader.Start(result.image, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    }
   }
 
-  std::string thumb = kodi::vfs::GetCacheThumbName(albumart.c_str());
-  thumb = thumb.substr(0,8);
-  std::string special = std::string("special://thumbnails/") + thumb.c_str()[0] + std::string("/") + thumb.c_str();
+  bool compressed = m_albumUploader.Busy() && m_albumUploader.Compressed();
+  GLuint album = m_albumUploader.Step();
+  if (!album)
+    return;
 
-  if (kodi::vfs::FileExists(special + std::string(".png")))
+  // Only compressed covers are kept, they are small enough to keep several
+  if (compressed)
   {
-    m_channelTextures[3] = CreateTexture(kodi::vfs::TranslateSpecialProtocol(special + std::string(".png")), GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
-    return true;
+    m_albumCache.Add(m_albumFile, album, m_albumUploader.TextureBytes(), m_albumUploader.PlainBytes());
+    SetAlbumTexture(album, 0, false);
   }
-  else if (kodi::vfs::FileExists(special + std::string(".jpg")))
+  else
   {
-    m_channelTextures[3] = CreateTexture(kodi::vfs::TranslateSpecialProtocol(special + std::string(".jpg")), GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
-    return true;
+    SetAlbumTexture(album, m_albumUploader.TextureBytes());
   }
+}
 
-  m_channelTextures[3] = CreateTexture(kodi::GetAddonPath("resources/textures/logo.png"), GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
-  
-  return false;
+CThreadPool& CVisualizationMatrix::ThreadPool()
+{
+  if (!m_threadPool)
+  {
+    m_threadPool.reset(new CThreadPool(CThreadPool::DefaultThreads()));
+    kodi::Log(ADDON_LOG_DEBUG, "Thread pool with %u threads", m_threadPool->Threads());
+  }
+  return *m_threadPool;
 }
 
 void CVisualizationMatrix::RenderTo(GLuint shader, GLuint effect_fb)
 {
   glUseProgram(shader);
 
-  if (shader == m_matrixShader.ProgramHandle())
+  const bool checkerboard = m_checkerboardActive && shader == m_matrixShader->ProgramHandle();
+  // The benchmark draws an offscreen frame before each visible one
+  if (checkerboard)
+    m_checkerboard.Select(effect_fb != 0);
+  const bool variableRate = m_variableRateActive && shader == m_matrixShader->ProgramHandle();
+  float t = 0.0f;
+  if (shader == m_matrixShader->ProgramHandle())
   {
     GLuint w = Width();
     GLuint h = Height();
@@ -358,19 +1395,36 @@ void CVisualizationMatrix::RenderTo(GLuint shader, GLuint effect_fb)
     if (m_bitsPrecision)
       intt &= (1<<m_bitsPrecision)-1;
 
-    if (m_needsUpload)
+    const GLubyte* rows = m_tuning ? nullptr : m_analysis.Acquire();
+    if (rows)
     {
-      for (int i = 0; i < 4; i++)
+      // The smoothed and quantized rows often repeat, e.g. in quiet
+      // passages, the texture on screen already shows them
+      if (!m_audioRows.Unchanged(m_audioTextureIndex, rows))
       {
-        if (m_shaderTextures[i].audio)
+        // Write the next texture of the ring, the previous frames may still be
+        // reading the others. Updating a texture in use forces the driver to
+        // stall or to make a shadow copy.
+        m_audioTextureIndex = (m_audioTextureIndex + 1) % AUDIO_TEXTURE_RING;
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_audioTextures[m_audioTextureIndex]);
+        // Only the changed part of each row, against what this texture got
+        // AUDIO_TEXTURE_RING updates ago
+        if (!m_audioRows.Update(m_audioTextureIndex, rows, m_audioSpans))
+        {
+          glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NUM_BANDS, 2, GL_RED, GL_UNSIGNED_BYTE, rows);
+        }
+        else
         {
-          glActiveTexture(GL_TEXTURE0 + i);
-          glBindTexture(GL_TEXTURE_2D, m_channelTextures[i]);
-          glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, NUM_BANDS, 2, 0, GL_RED, GL_UNSIGNED_BYTE, m_audioData);
+          for (int y = 0; y < 2; y++)
+          {
+            const CDirtyRows::Span& span = m_audioSpans[y];
+            if (span.begin != span.end)
+              glTexSubImage2D(GL_TEXTURE_2D, 0, span.begin, y, span.end - span.begin, 1, GL_RED, GL_UNSIGNED_BYTE,
+                              rows + y * NUM_BANDS + span.begin);
+          }
         }
       }
-      m_needsUpload = false;
-
 
       if (g_presets[m_currentPreset].channel[3] == 2)
       {
@@ -380,6 +1434,9 @@ void CVisualizationMatrix::RenderTo(GLuint shader, GLuint effect_fb)
         GLfloat g = std::max(sin(delta - 1.0f),0.0f)*0.7f;
         GLfloat b = std::max(sin(delta - 2.0f),0.0f)*0.7f;
         glUniform3f(m_attrAlbumRGBLoc, r, g, b);
+        m_albumRGB[0] = r;
+        m_albumRGB[1] = g;
+        m_albumRGB[2] = b;
         if (m_lastAlbumChange == 0.0)
         {
           glUniform3f(m_attrAlbumPositionLoc, 0.f, 0.f, 2.0f);
@@ -399,7 +1456,39 @@ void CVisualizationMatrix::RenderTo(GLuint shader, GLuint effect_fb)
       }
     }
 
-    float t = intt / 1000.0f;
+    t = m_frozenTime >= 0.0f ? m_frozenTime : intt / 1000.0f;
+
+    if (m_cellPassActive)
+    {
+      RenderCells(t);
+      glUseProgram(shader);
+      glActiveTexture(GL_TEXTURE5);
+      glUniform1i(m_attrCellsLoc, 5);
+      glBindTexture(GL_TEXTURE_2D, m_cellTexture);
+    }
+
+    if (m_hybridActive)
+    {
+      // The cells of this frame were computed while the previous one was
+      // drawn, only the first frame has to wait for the whole computation
+      if (!m_cellRenderer->Started())
+        StartCells(t);
+      const uint8_t* cells = m_cellRenderer->Finish();
+      m_hybridTextureIndex = (m_hybridTextureIndex + 1) % AUDIO_TEXTURE_RING;
+      glActiveTexture(GL_TEXTURE5);
+      glUniform1i(m_attrCellsLoc, 5);
+      glBindTexture(GL_TEXTURE_2D, m_hybridTextures[m_hybridTextureIndex]);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_cellWidth, m_cellHeight, GL_RED, GL_UNSIGNED_BYTE, cells);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      if (m_capturePending)
+        m_capturedCells.assign(cells, cells + m_cellWidth * m_cellHeight);
+
+      // Expect the next frame as far ahead as the last one
+      float next = t + std::min(std::max(t - m_lastCellTime, 0.0f), 0.1f);
+      m_lastCellTime = t;
+      StartCells(next);
+    }
 
     glUniform1f(m_attrGlobalTimeLoc, t);
 
@@ -407,8 +1496,21 @@ void CVisualizationMatrix::RenderTo(GLuint shader, GLuint effect_fb)
     {
       glActiveTexture(GL_TEXTURE0 + i);
       glUniform1i(m_attrChannelLoc[i], i);
-      glBindTexture(GL_TEXTURE_2D, m_channelTextures[i]);
+      glBindTexture(GL_TEXTURE_2D, m_shaderTextures[i].audio ? m_audioTextures[m_audioTextureIndex] : m_channelTextures[i]);
+    }
+
+    if (m_shaderVariant & SHADER_VARIANT_DOT_LUT)
+    {
+      glActiveTexture(GL_TEXTURE4);
+      glUniform1i(m_attrDotLUTLoc, 4);
+      glBindTexture(GL_TEXTURE_2D, m_dotLUTTexture);
     }
+
+    if (checkerboard)
+      glUniform1f(m_attrParityLoc, static_cast<float>(m_checkerboard.Parity()));
+
+    if (m_capturePending && !effect_fb && !m_tuning)
+      CaptureFrame();
   }
   else
   {
@@ -417,41 +1519,58 @@ void CVisualizationMatrix::RenderTo(GLuint shader, GLuint effect_fb)
     glUniform1i(m_state.uTexture, 0); // first currently bound texture "GL_TEXTURE0"
   }
 
-  // Draw the effect to a texture or direct to framebuffer
-  glBindFramebuffer(GL_FRAMEBUFFER, effect_fb);
+  auto draw = [this]()
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, m_state.vertex_buffer);
+    glVertexAttribPointer(m_state.attr_vertex_e, 4, GL_FLOAT, 0, 16, 0);
+    glEnableVertexAttribArray(m_state.attr_vertex_e);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+    glDisableVertexAttribArray(m_state.attr_vertex_e);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  };
 
-  glBindBuffer(GL_ARRAY_BUFFER, m_state.vertex_buffer);
-  glVertexAttribPointer(m_state.attr_vertex_e, 4, GL_FLOAT, 0, 16, 0);
-  glEnableVertexAttribArray(m_state.attr_vertex_e);
-  glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-  glDisableVertexAttribArray(m_state.attr_vertex_e);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  // Draw the effect to a texture or direct to framebuffer
+  if (variableRate)
+  {
+    m_variableRate.Render(effect_fb, m_attrPixelScaleLoc, m_state.vertex_buffer, draw);
+  }
+  else
+  {
+    if (checkerboard)
+      m_checkerboard.Begin();
+    else
+      glBindFramebuffer(GL_FRAMEBUFFER, effect_fb);
+    draw();
+  }
 
-  for (int i = 0; i < 4; i++)
+  for (int i = 0; i < 6; i++)
   {
     glActiveTexture(GL_TEXTURE0 + i);
     glBindTexture(GL_TEXTURE_2D, 0);
   }
 
   glUseProgram(0);
+
+  if (checkerboard)
+    m_checkerboard.Resolve(effect_fb, m_state.vertex_buffer, t, m_checkerboardMode, m_dotLUTTexture);
 }
 
-void CVisualizationMatrix::Mix(float* destination, const float* source, size_t frames, size_t channels)
+void CVisualizationMatrix::Mix(float* destination, const float* source, size_t frames, size_t channels, size_t mixChannels)
 {
   size_t length = frames * channels;
   for (unsigned int i = 0; i < length; i += channels)
   {
     float v = 0.0f;
-    for (size_t j = 0; j < channels; j++)
+    for (size_t j = 0; j < mixChannels; j++)
     {
       v += source[i + j];
     }
 
-    destination[(i / 2)] = v / (float)channels;
+    destination[(i / 2)] = v / (float)mixChannels;
   }
 }
 
-void CVisualizationMatrix::WriteToBuffer(const float* input, size_t length, size_t channels)
+void CVisualizationMatrix::WriteToBuffer(const float* input, size_t length, size_t channels, size_t mixChannels)
 {
   size_t frames = length / channels;
 
@@ -459,24 +1578,32 @@ void CVisualizationMatrix::WriteToBuffer(const float* input, size_t length, size
   {
     size_t offset = frames - AUDIO_BUFFER;
 
-    Mix(m_pcm, input + offset, AUDIO_BUFFER, channels);
+    Mix(m_analysis.Pcm(), input + offset, AUDIO_BUFFER, channels, mixChannels);
   }
   else
   {
     size_t keep = AUDIO_BUFFER - frames;
-    memmove(m_pcm, m_pcm + frames, keep * sizeof(float));
+    float* pcm = m_analysis.Pcm();
+    memmove(pcm, pcm + frames, keep * sizeof(float));
 
-    Mix(m_pcm + keep, input, frames, channels);
+    Mix(pcm + keep, input, frames, channels, mixChannels);
   }
 }
 
 void CVisualizationMatrix::Launch(int preset)
 {
-  m_bitsPrecision = DetermineBitsPrecision();
-  // mali-400 has only 10 bits which means milliseond timer wraps after ~1 second.
-  // we'll fudge that up a bit as having a larger range is more important than ms accuracy
-  m_bitsPrecision = std::max(m_bitsPrecision, 13);
-  kodi::Log(ADDON_LOG_DEBUG, "bits of precision: %d", m_bitsPrecision);
+  // Only probe once per GL context
+  if (!m_bitsPrecision)
+  {
+    m_bitsPrecision = DetermineBitsPrecision();
+    // mali-400 has only 10 bits which means milliseond timer wraps after ~1 second.
+    // we'll fudge that up a bit as having a larger range is more important than ms accuracy
+    m_bitsPrecision = std::max(m_bitsPrecision, 13);
+    kodi::Log(ADDON_LOG_DEBUG, "bits of precision: %d", m_bitsPrecision);
+
+    m_albumFormat = m_compressAlbums ? CTextureCompressor::SupportedFormat() : 0;
+    kodi::Log(ADDON_LOG_DEBUG, "album texture format: %s", CTextureCompressor::FormatName(m_albumFormat));
+  }
 
   UnloadTextures();
 
@@ -498,53 +1625,342 @@ void CVisualizationMatrix::Launch(int preset)
     }
   }
   // Audio
-  m_channelTextures[0] = CreateTexture(GL_RED, NUM_BANDS, 2, m_audioData);
-  // Logo
-  if (!m_shaderTextures[1].texture.empty())
+  for (int i = 0; i < AUDIO_TEXTURE_RING; i++)
+    m_audioTextures[i] = CreateTexture(GL_RED, NUM_BANDS, 2, m_analysis.Rows());
+  m_audioTextureIndex = 0;
+  m_audioRows.Reset(m_analysis.Rows());
+  size_t textureBytes = AUDIO_TEXTURE_RING * NUM_BANDS * 2;
+  // Logo, noise and album, only the noise is tiled
+  for (int i = 1; i < 4; i++)
+  {
+    if (m_shaderTextures[i].texture.empty())
+      continue;
+
+    kodi::Log(ADDON_LOG_DEBUG, "creating texture %s\n", m_shaderTextures[i].texture.c_str());
+    const CImage image = LoadChannelImage(i);
+    if (i == CCellRenderer::CHANNEL_LOGO && !image.Empty())
+    {
+      // One channel is enough for the distance
+      const std::vector<unsigned char> distance = image.Channel(0);
+      m_channelTextures[i] = CreateTexture(GL_RED, image.Width(), image.Height(), distance.data());
+      textureBytes += distance.size();
+      continue;
+    }
+    m_channelTextures[i] = CreateTexture(image, GL_RGBA, GL_LINEAR, i == 2 ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+    textureBytes += static_cast<size_t>(image.Width()) * image.Height() * 4;
+  }
+
+  m_state.fbwidth = Width();
+  m_state.fbheight = Height();
+  m_shaderVariant = SelectShaderVariant();
+  if ((m_shaderVariant & SHADER_VARIANT_DOT_LUT) && !m_dotLUTTexture)
+    m_dotLUTTexture = CreateDotLUT();
+  if (m_dotLUTTexture)
+    textureBytes += DOT_LUT_SIZE * DOT_LUT_SIZE * 4;
+  m_memory.SetUsed(CMemoryBudget::TEXTURES, textureBytes);
+  LoadPreset(m_usedShaderFile);
+}
+
+std::string CVisualizationMatrix::RendererName()
+{
+  const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+  std::string name = renderer ? renderer : "unknown";
+  // Used in device profile keys, which must not contain the separator
+  std::replace(name.begin(), name.end(), '=', '_');
+  return name;
+}
+
+int CVisualizationMatrix::SelectShaderVariant()
+{
+  std::string key = "shader." + RendererName() + "." + g_presets[m_currentPreset].file + (m_lowpower ? ".lowpower" : "");
+
+  m_autotune.active = false;
+  if (m_profile.Has(key))
+    return std::atoi(m_profile.Get(key).c_str());
+
+  // The default variant is what the preset always looked like, the others
+  // are only accepted if they render the same image. They are measured over
+  // the next frames, until then the default is used.
+  m_autotune.variants = {SHADER_VARIANT_DEFAULT};
+#if !defined(HAS_GL)
+  m_autotune.variants.push_back(SHADER_VARIANT_HIGHP);
+#endif
+  if (!m_lowpower)
   {
-    m_channelTextures[1] = CreateTexture(m_shaderTextures[1].texture, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    size_t count = m_autotune.variants.size();
+    for (size_t i = 0; i < count; i++)
+      m_autotune.variants.push_back(m_autotune.variants[i] | SHADER_VARIANT_DOT_LUT);
+    if (!m_dotLUTTexture)
+      m_dotLUTTexture = CreateDotLUT();
   }
-  // Noise
-  if (!m_shaderTextures[2].texture.empty())
+  m_autotune.active = true;
+  m_autotune.key = key;
+  m_autotune.next = 0;
+  m_autotune.frames = -1;
+  m_autotune.times.clear();
+  m_autotune.best = SHADER_VARIANT_DEFAULT;
+  m_autotune.bestTime = 0.0;
+  m_autotune.reference.clear();
+  return SHADER_VARIANT_DEFAULT;
+}
+
+void CVisualizationMatrix::AutotuneFrame()
+{
+  // One step per visible frame: a variant is loaded and checked in one,
+  // then timed for VARIANT_TUNE_FRAMES, one offscreen frame each
+  const int variant = m_autotune.variants[m_autotune.next];
+  m_tuning = true;
+  if (m_autotune.frames < 0)
   {
-    m_channelTextures[2] = CreateTexture(m_shaderTextures[2].texture, GL_RGBA, GL_LINEAR, GL_REPEAT);
+    m_shaderVariant = variant;
+    LoadPreset(m_usedShaderFile);
+    bool accepted = m_matrixShader->IsOk();
+    if (accepted)
+    {
+      // Check the result with a fixed time
+      std::vector<unsigned char> image(static_cast<size_t>(m_state.fbwidth) * m_state.fbheight * 4);
+      m_frozenTime = 12.34f;
+      RenderTo(m_matrixShader->ProgramHandle(), m_state.effect_fb);
+      glBindFramebuffer(GL_FRAMEBUFFER, m_state.effect_fb);
+      glReadPixels(0, 0, m_state.fbwidth, m_state.fbheight, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+      if (variant == SHADER_VARIANT_DEFAULT)
+      {
+        m_autotune.reference.swap(image);
+      }
+      else
+      {
+        double difference = ImageDifference(image, m_autotune.reference);
+        if (difference > VARIANT_TUNE_TOLERANCE)
+        {
+          kodi::Log(ADDON_LOG_DEBUG, "Shader variant %i rejected, difference %f", variant, difference);
+          accepted = false;
+        }
+      }
+    }
+
+    if (accepted)
+    {
+      m_autotune.frames = 0;
+      m_autotune.times.clear();
+    }
+    else
+    {
+      // The visible frames never show a rejected variant
+      m_autotune.next++;
+      if (m_autotune.next < m_autotune.variants.size())
+      {
+        m_shaderVariant = m_autotune.best;
+        LoadPreset(m_usedShaderFile);
+      }
+    }
   }
-  // Album
-  if (!m_shaderTextures[3].texture.empty())
+  else
   {
-    m_channelTextures[3] = CreateTexture(m_shaderTextures[3].texture, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    CGPUTimer timer;
+    m_frozenTime = m_autotune.frames * 0.016f;
+    timer.Begin();
+    RenderTo(m_matrixShader->ProgramHandle(), m_state.effect_fb);
+    m_autotune.times.push_back(timer.End());
+    m_autotune.frames++;
+
+    if (m_autotune.frames >= VARIANT_TUNE_FRAMES)
+    {
+      std::vector<double>& times = m_autotune.times;
+      std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+      double frameTime = times[times.size() / 2];
+      kodi::Log(ADDON_LOG_DEBUG, "Shader variant %i: %.3f ms median over %i frames", variant, frameTime, m_autotune.frames);
+      if (variant == SHADER_VARIANT_DEFAULT)
+      {
+        m_autotune.best = variant;
+        m_autotune.bestTime = frameTime;
+      }
+      else if (frameTime < m_autotune.bestTime * (1.0 - VARIANT_TUNE_MARGIN))
+      {
+        m_autotune.best = variant;
+        m_autotune.bestTime = frameTime;
+      }
+      m_autotune.next++;
+      m_autotune.frames = -1;
+    }
   }
+  m_frozenTime = -1.0f;
+  m_tuning = false;
 
-  m_state.fbwidth = Width();
-  m_state.fbheight = Height();
+  if (m_autotune.next < m_autotune.variants.size())
+    return;
+
+  m_autotune.active = false;
+  m_autotune.reference.clear();
+  m_autotune.times.clear();
+  m_profile.Set(m_autotune.key, std::to_string(m_autotune.best));
+  m_profile.Save();
+  kodi::Log(ADDON_LOG_INFO, "Using shader variant %i for %s", m_autotune.best, g_presets[m_currentPreset].file.c_str());
+
+  // Also drops the offscreen target of the measurement
+  m_shaderVariant = m_autotune.best;
   LoadPreset(m_usedShaderFile);
 }
 
-void CVisualizationMatrix::UnloadTextures()
+double CVisualizationMatrix::ImageDifference(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference)
 {
-  for (int i = 0; i < 4; i++)
+  // Mean difference per color channel of two RGBA images
+  const size_t pixels = std::min(image.size(), reference.size()) / 4;
+  double difference = 0.0;
+  for (size_t i = 0; i < pixels * 4; i++)
+    difference += std::abs(static_cast<int>(image[i]) - static_cast<int>(reference[i]));
+  return difference / std::max<size_t>(pixels * 3, 1);
+}
+
+std::vector<unsigned char> CVisualizationMatrix::RenderStill()
+{
+  // Two frames a frame apart with the audio kept, so a checkerboard has the
+  // previous frame to rebuild from
+  std::vector<unsigned char> image(static_cast<size_t>(m_state.fbwidth) * m_state.fbheight * 4);
+  m_tuning = true;
+  m_frozenTime = 12.34f - 1.0f / 60.0f;
+  RenderTo(m_matrixShader->ProgramHandle(), m_state.effect_fb);
+  m_frozenTime = 12.34f;
+  RenderTo(m_matrixShader->ProgramHandle(), m_state.effect_fb);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_state.effect_fb);
+  glReadPixels(0, 0, m_state.fbwidth, m_state.fbheight, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  m_frozenTime = -1.0f;
+  m_tuning = false;
+  return image;
+}
+
+GLuint CVisualizationMatrix::CreateDotLUT()
+{
+  std::vector<GLubyte> lut = DotLUT();
+  return CreateTexture(lut.data(), GL_RGBA, DOT_LUT_SIZE, DOT_LUT_SIZE, GL_RGBA, GL_LINEAR, GL_REPEAT);
+}
+
+std::vector<GLubyte> CVisualizationMatrix::DotLUT()
+{
+  // Same shape as bw2col: peak in the red, base in the green channel
+  auto smoothstep = [](float edge0, float edge1, float x)
+  {
+    float t = std::max(std::min((x - edge0) / (edge1 - edge0), 1.0f), 0.0f);
+    return t * t * (3.0f - 2.0f * t);
+  };
+
+  std::vector<GLubyte> lut(DOT_LUT_SIZE * DOT_LUT_SIZE * 4);
+  for (int y = 0; y < DOT_LUT_SIZE; y++)
   {
-    if (m_channelTextures[i])
+    for (int x = 0; x < DOT_LUT_SIZE; x++)
     {
-      glDeleteTextures(1, &m_channelTextures[i]);
-      m_channelTextures[i] = 0;
+      float dx = (x + 0.5f) / DOT_LUT_SIZE - 0.5f;
+      float dy = (y + 0.5f) / DOT_LUT_SIZE - 0.5f;
+      float d = sqrtf(dx * dx + dy * dy);
+      GLubyte* texel = &lut[(y * DOT_LUT_SIZE + x) * 4];
+      texel[0] = static_cast<GLubyte>(smoothstep(.35f, .0f, d) * 255.0f + 0.5f);
+      texel[1] = static_cast<GLubyte>(smoothstep(.85f, .0f, d) * 255.0f + 0.5f);
+      texel[2] = 0;
+      texel[3] = 255;
     }
   }
+  return lut;
+}
+
+void CVisualizationMatrix::UnloadTextures()
+{
+  m_albumUploader.Cancel();
+  for (int i = 0; i < 4; i++)
+  {
+    if (i != 3 || m_albumTextureOwned)
+      m_deletionQueue.DeleteTexture(m_channelTextures[i]);
+    m_channelTextures[i] = 0;
+  }
+  m_albumTextureOwned = true;
+  m_albumTextureBytes = 0;
+  m_memory.SetUsed(CMemoryBudget::TEXTURES, 0);
+  for (int i = 0; i < AUDIO_TEXTURE_RING; i++)
+  {
+    m_deletionQueue.DeleteTexture(m_audioTextures[i]);
+    m_audioTextures[i] = 0;
+  }
 }
 
-void CVisualizationMatrix::LoadPreset(const std::string& shaderPath)
+void CVisualizationMatrix::LoadPreset(const std::string& shaderPath, bool cellPass)
 {
   UnloadPreset();
+
+  // Presets are compiled from their stages, other shaders are used as is
+  std::string fragmentShader = shaderPath;
+  CPresetCompiler::Options options;
+  CPresetCompiler::Result preset;
+  if (shaderPath.size() > 7 && shaderPath.compare(shaderPath.size() - 7, 7, ".stages") == 0)
+  {
+    CPresetCompiler compiler;
+    options.lowpower = m_lowpower;
+    options.cellPass = m_cellPass && cellPass;
+    options.hybrid = m_hybrid;
+    if (compiler.Load(shaderPath))
+      preset = compiler.Compile(options);
+    if (!preset.ok)
+      return;
+    fragmentShader = kodi::GetAddonPath("resources/shaders/preset.frag.glsl");
+    kodi::Log(ADDON_LOG_DEBUG, "Compiled preset '%s'\n%s", shaderPath.c_str(), preset.fragment.c_str());
+  }
+  m_cellPassActive = !preset.cellFragment.empty();
+  m_hybridActive = options.hybrid;
+
+  // The autotuner compares full images, the resolve needs the rain of a
+  // compiled preset
+  const size_t checkerboardBytes = CCheckerboard::Bytes(m_state.fbwidth, m_state.fbheight);
+  m_checkerboardActive = m_checkerboardMode != CHECKERBOARD_OFF && !m_tuning && preset.ok &&
+                         (m_benchmark.active || m_memory.Fits(CMemoryBudget::FRAMEBUFFERS, checkerboardBytes));
+  const float cellSize = m_state.fbheight * m_dotSize * 2.0f / Width();
+  m_variableRateActive = m_variableRateShading && !m_checkerboardActive && !m_tuning && preset.ok &&
+                         m_variableRate.Setup(m_state.fbwidth, m_state.fbheight, preset.vignette, cellSize) &&
+                         (m_benchmark.active || m_memory.Fits(CMemoryBudget::FRAMEBUFFERS, m_variableRate.Bytes()));
+
   GatherDefines();
   std::string vertMatrixShader = kodi::GetAddonPath("resources/shaders/main_matrix_" GL_TYPE_STRING ".vert.glsl");
-  if (!m_matrixShader.LoadShaderFiles(vertMatrixShader, shaderPath) ||
-      !m_matrixShader.CompileAndLink("", "", m_defines, ""))
+  if (!m_matrixShader->LoadShaderFiles(vertMatrixShader, fragmentShader) ||
+      !m_matrixShader->CompileAndLink(m_vertexDefines, "", m_defines, preset.fragment))
   {
     kodi::Log(ADDON_LOG_ERROR, "Failed to compile matrix shaders (current file '%s')", shaderPath.c_str());
+    m_cellPassActive = m_hybridActive = m_checkerboardActive = m_variableRateActive = false;
+    return;
+  }
+
+  if (m_checkerboardActive && !m_checkerboard.Load(m_state.fbwidth, m_state.fbheight, preset.rainBase,
+                                                    vertMatrixShader, fragmentShader, m_vertexDefines, m_defines))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to set up checkerboard rendering, shading every pixel");
+    m_checkerboardMode = CHECKERBOARD_OFF;
+    LoadPreset(shaderPath, cellPass);
+    return;
+  }
+
+  if (m_variableRateActive && !m_variableRate.Load(vertMatrixShader, fragmentShader, m_vertexDefines, m_defines))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to set up variable rate shading, shading every pixel at full rate");
+    m_variableRateShading = false;
+    LoadPreset(shaderPath, cellPass);
+    return;
+  }
+  if (m_variableRateActive)
+  {
+    const int* center = m_variableRate.Center();
+    kodi::Log(ADDON_LOG_DEBUG, "Variable rate shading: full rate in %ix%i at %i,%i, %.0f%% of the shading cost",
+              center[2], center[3], center[0], center[1], m_variableRate.Shaded() * 100.0f);
+  }
+
+  if (m_cellPassActive && !LoadCellPass(vertMatrixShader, fragmentShader, preset.cellFragment))
+  {
+    kodi::Log(ADDON_LOG_ERROR, "Failed to compile the cell pass, computing per pixel");
+    LoadPreset(shaderPath, false);
     return;
   }
 
-  GLuint matrixShader = m_matrixShader.ProgramHandle();
+  if (m_hybridActive)
+    SetupCellRenderer(preset.cellProgram);
+
+  GLuint matrixShader = m_matrixShader->ProgramHandle();
 
   m_attrGlobalTimeLoc = glGetUniformLocation(matrixShader, "iTime");
   m_attrAlbumPositionLoc = glGetUniformLocation(matrixShader, "iAlbumPosition");
@@ -553,22 +1969,68 @@ void CVisualizationMatrix::LoadPreset(const std::string& shaderPath)
   m_attrChannelLoc[1] = glGetUniformLocation(matrixShader, "iChannel1");
   m_attrChannelLoc[2] = glGetUniformLocation(matrixShader, "iChannel2");
   m_attrChannelLoc[3] = glGetUniformLocation(matrixShader, "iChannel3");
+  m_attrDotLUTLoc = glGetUniformLocation(matrixShader, "iDotLUT");
+  m_attrCellsLoc = glGetUniformLocation(matrixShader, "iCells");
+  m_attrParityLoc = glGetUniformLocation(matrixShader, "iParity");
+  m_attrPixelScaleLoc = glGetUniformLocation(matrixShader, "iPixelScale");
+  if (m_attrPixelScaleLoc >= 0)
+  {
+    // Full rate unless drawing the edges, also for frame captures
+    glUseProgram(matrixShader);
+    glUniform1f(m_attrPixelScaleLoc, 1.0f);
+    glUseProgram(0);
+  }
 
   m_state.attr_vertex_e = glGetAttribLocation(matrixShader,  "vertex");
 
-  // Prepare a texture to render to
-  glActiveTexture(GL_TEXTURE0);
-  glGenTextures(1, &m_state.framebuffer_texture);
-  glBindTexture(GL_TEXTURE_2D, m_state.framebuffer_texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_state.fbwidth, m_state.fbheight, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  // Prepare a framebuffer for rendering
-  glGenFramebuffers(1, &m_state.effect_fb);
-  glBindFramebuffer(GL_FRAMEBUFFER, m_state.effect_fb);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_state.framebuffer_texture, 0);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  // Kept for frame captures, the same parts as handed to CompileAndLink()
+  m_matrixSources = CFrameCapture::Program();
+  m_matrixSources.vertexBegin = m_vertexDefines;
+  m_matrixSources.vertex = CFrameCapture::ReadSource(vertMatrixShader);
+  m_matrixSources.fragmentBegin = m_defines;
+  m_matrixSources.fragment = CFrameCapture::ReadSource(fragmentShader);
+  m_matrixSources.fragmentEnd = preset.fragment;
+  m_cellSources = CFrameCapture::Program();
+  if (m_cellPassActive)
+  {
+    m_cellSources = m_matrixSources;
+    m_cellSources.fragmentEnd = preset.cellFragment;
+  }
+  m_memory.SetUsed(CMemoryBudget::SHADERS, m_matrixSources.Bytes() + m_cellSources.Bytes());
+
+  // Only the precision probe, the autotuner and the benchmark render to the
+  // effect framebuffer, it is left out when the memory budget is too tight
+  size_t framebufferBytes = m_checkerboardActive ? checkerboardBytes : 0;
+  if (m_variableRateActive)
+    framebufferBytes += m_variableRate.Bytes();
+  if (m_cellTexture)
+    framebufferBytes += static_cast<size_t>(m_cellWidth) * m_cellHeight * 4;
+  if (m_hybridActive)
+    framebufferBytes += AUDIO_TEXTURE_RING * static_cast<size_t>(m_cellWidth) * m_cellHeight + m_cellRenderer->Bytes();
+  const size_t effectBytes = static_cast<size_t>(m_state.fbwidth) * m_state.fbheight * 4;
+  const bool offscreen = !m_bitsPrecision || m_tuning || m_benchmark.active;
+  if (offscreen || m_memory.Fits(CMemoryBudget::FRAMEBUFFERS, framebufferBytes + effectBytes))
+  {
+    // Prepare a texture to render to
+    glActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &m_state.framebuffer_texture);
+    glBindTexture(GL_TEXTURE_2D, m_state.framebuffer_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_state.fbwidth, m_state.fbheight, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Prepare a framebuffer for rendering
+    glGenFramebuffers(1, &m_state.effect_fb);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_state.effect_fb);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_state.framebuffer_texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebufferBytes += effectBytes;
+  }
+  else
+  {
+    kodi::Log(ADDON_LOG_DEBUG, "Memory budget: no effect framebuffer for %ix%i", m_state.fbwidth, m_state.fbheight);
+  }
+  m_memory.SetUsed(CMemoryBudget::FRAMEBUFFERS, framebufferBytes);
 
   m_initialTime = static_cast<int64_t>(std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() * 1000.0);
   m_initialTime += (m_initialTime % 100000);
@@ -576,16 +2038,160 @@ void CVisualizationMatrix::LoadPreset(const std::string& shaderPath)
 
 void CVisualizationMatrix::UnloadPreset()
 {
-  if (m_state.framebuffer_texture)
+  m_deletionQueue.DeleteTexture(m_state.framebuffer_texture);
+  m_state.framebuffer_texture = 0;
+  m_deletionQueue.DeleteFramebuffer(m_state.effect_fb);
+  m_state.effect_fb = 0;
+  m_memory.SetUsed(CMemoryBudget::FRAMEBUFFERS, 0);
+  m_memory.SetUsed(CMemoryBudget::SHADERS, 0);
+  m_deletionQueue.DeleteTexture(m_cellTexture);
+  m_cellTexture = 0;
+  m_deletionQueue.DeleteFramebuffer(m_cellFB);
+  m_cellFB = 0;
+  m_checkerboard.Unload();
+  m_variableRate.Unload();
+  for (int i = 0; i < AUDIO_TEXTURE_RING; i++)
+  {
+    m_deletionQueue.DeleteTexture(m_hybridTextures[i]);
+    m_hybridTextures[i] = 0;
+  }
+}
+
+void CVisualizationMatrix::SetupCellRenderer(const CPresetCompiler::CellProgram& program)
+{
+  if (!m_cellRenderer)
+    m_cellRenderer.reset(new CCellRenderer(ThreadPool()));
+
+  CCellRenderer::Setup setup;
+  setup.program = program;
+  setup.width = m_cellWidth;
+  setup.height = m_cellHeight;
+  setup.offsetX = -m_cellWidth / 2;
+  setup.offsetY = -m_cellHeight / 2;
+  setup.columns = static_cast<float>(Width())/(m_dotSize*2.0f);
+  setup.resolutionX = m_state.fbwidth ? m_state.fbwidth : Width();
+  setup.resolutionY = m_state.fbheight ? m_state.fbheight : Height();
+  setup.dotSize = m_dotSize;
+  setup.noiseFluctuation = m_noiseFluctuation;
+  setup.distortThreshold = m_distortThreshold;
+  setup.lowpower = m_lowpower;
+  setup.bands = NUM_BANDS;
+  m_cellRenderer->Configure(setup);
+
+  // The CPU samples its own copies of the logo and the noise, the album is
+  // handed over by SetAlbumImage()
+  for (int channel : {CCellRenderer::CHANNEL_LOGO, CCellRenderer::CHANNEL_NOISE})
+    m_cellRenderer->SetImage(channel, LoadChannelImage(channel));
+
+  for (int i = 0; i < AUDIO_TEXTURE_RING; i++)
+  {
+    m_hybridTextures[i] = CreateTexture(GL_RED, m_cellWidth, m_cellHeight, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  m_hybridTextureIndex = 0;
+  m_lastCellTime = 0.0f;
+}
+
+void CVisualizationMatrix::StartCells(float time)
+{
+  CCellRenderer::Frame frame;
+  frame.time = time;
+  frame.audio = m_analysis.Rows();
+  frame.albumPosition[0] = m_albumX;
+  frame.albumPosition[1] = m_albumY;
+  for (int i = 0; i < 3; i++)
+    frame.albumRGB[i] = m_albumRGB[i];
+  m_cellRenderer->Start(frame);
+}
+
+bool CVisualizationMatrix::LoadCellPass(const std::string& vertexShader, const std::string& fragmentShader, const std::string& main)
+{
+  // Stages depending only on the cell are computed once per cell into a
+  // small texture, the main pass reads them back with a single fetch
+  if (!m_cellShader->LoadShaderFiles(vertexShader, fragmentShader) ||
+      !m_cellShader->CompileAndLink(m_vertexDefines, "", m_defines, main))
+    return false;
+
+  GLuint cellShader = m_cellShader->ProgramHandle();
+  m_cellTimeLoc = glGetUniformLocation(cellShader, "iTime");
+  m_cellNoiseLoc = glGetUniformLocation(cellShader, "iChannel2");
+  m_cellVertexLoc = glGetAttribLocation(cellShader, "vertex");
+
+  glActiveTexture(GL_TEXTURE0);
+  glGenTextures(1, &m_cellTexture);
+  glBindTexture(GL_TEXTURE_2D, m_cellTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_cellWidth, m_cellHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &m_cellFB);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_cellFB);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_cellTexture, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return true;
+}
+
+void CVisualizationMatrix::RenderCells(float time)
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLboolean blend = glIsEnabled(GL_BLEND);
+  glDisable(GL_BLEND);
+
+  glUseProgram(m_cellShader->ProgramHandle());
+  glUniform1f(m_cellTimeLoc, time);
+  if (m_cellNoiseLoc >= 0)
   {
-    glDeleteTextures(1, &m_state.framebuffer_texture);
-    m_state.framebuffer_texture = 0;
+    glActiveTexture(GL_TEXTURE2);
+    glUniform1i(m_cellNoiseLoc, 2);
+    glBindTexture(GL_TEXTURE_2D, m_channelTextures[2]);
   }
-  if (m_state.effect_fb)
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_cellFB);
+  glViewport(0, 0, m_cellWidth, m_cellHeight);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_state.vertex_buffer);
+  glVertexAttribPointer(m_cellVertexLoc, 4, GL_FLOAT, 0, 16, 0);
+  glEnableVertexAttribArray(m_cellVertexLoc);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+  glDisableVertexAttribArray(m_cellVertexLoc);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  if (blend)
+    glEnable(GL_BLEND);
+}
+
+CImage CVisualizationMatrix::LoadChannelImage(int channel)
+{
+  const std::string& file = m_shaderTextures[channel].texture;
+  CImage image;
+  if (file.empty())
+    return image;
+
+  // The logo stage only reads the distance to the logo's shape, the baked
+  // shadow of the image is left out. The transform takes far longer than
+  // the decode, it is done once and shared by the texture, the CPU cells
+  // and the captures.
+  if (channel == CCellRenderer::CHANNEL_LOGO)
   {
-    glDeleteFramebuffers(1, &m_state.effect_fb);
-    m_state.effect_fb = 0;
+    if (m_logoField.Empty() || m_logoFieldFile != file)
+    {
+      m_logoFieldFile = file;
+      m_logoField = CImage();
+      if (image.Load(file))
+        m_logoField = image.DistanceField(LOGO_SDF_SIZE, static_cast<float>(LOGO_SDF_SPREAD));
+    }
+    return m_logoField;
   }
+
+  image.Load(file);
+  return image;
 }
 
 GLuint CVisualizationMatrix::CreateTexture(GLint format, unsigned int w, unsigned int h, const GLvoid* data)
@@ -623,24 +2229,29 @@ GLuint CVisualizationMatrix::CreateTexture(const GLvoid* data, GLint format, uns
   return texture;
 }
 
-GLuint CVisualizationMatrix::CreateTexture(const std::string& file, GLint internalFormat, GLint scaling, GLint repeat)
+GLuint CVisualizationMatrix::CreateTexture(const CImage& image, GLint internalFormat, GLint scaling, GLint repeat)
 {
-  kodi::Log(ADDON_LOG_DEBUG, "creating texture %s\n", file.c_str());
-
-  int width,height,n;
-  unsigned char* image;
-  stbi_set_flip_vertically_on_load(true);
-  
-  image = stbi_load(file.c_str(), &height, &width, &n, STBI_rgb_alpha);
-  if (image == nullptr)
-  {
-    kodi::Log(ADDON_LOG_ERROR, "couldn't load image");
+  if (image.Empty())
     return 0;
-  }  
 
-  GLuint texture = CreateTexture(image, GL_RGBA, width, height, internalFormat, scaling, repeat);
-  stbi_image_free(image);
-  image = nullptr;
+  return CreateTexture(image.Data(), GL_RGBA, image.Width(), image.Height(), internalFormat, scaling, repeat);
+}
+
+GLuint CVisualizationMatrix::CreateTexture(const CTextureData::Level& level, GLenum format, GLint scaling, GLint repeat)
+{
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, scaling);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, scaling);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, repeat);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, repeat);
+
+  glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, level.width, level.height, 0,
+                         static_cast<GLsizei>(level.data.size()), level.data.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
 
   return texture;
 }
@@ -677,7 +2288,7 @@ int CVisualizationMatrix::DetermineBitsPrecision()
 {
   m_state.fbwidth = 32, m_state.fbheight = 26*10;
   LoadPreset(kodi::GetAddonPath("resources/shaders/main_test.frag.glsl"));
-  RenderTo(m_matrixShader.ProgramHandle(), m_state.effect_fb);
+  RenderTo(m_matrixShader->ProgramHandle(), m_state.effect_fb);
   glFinish();
 
   unsigned char* buffer = new unsigned char[m_state.fbwidth * m_state.fbheight * 4];
@@ -709,8 +2320,21 @@ void CVisualizationMatrix::GatherDefines()
 #else
   m_defines += "#version 100\n\n";
   m_defines += "#extension GL_OES_standard_derivatives : enable\n\n";
-  m_defines += "precision mediump float;\n";
-  m_defines += "precision mediump int;\n\n";
+  if (m_shaderVariant & SHADER_VARIANT_HIGHP)
+  {
+    m_defines += "#ifdef GL_FRAGMENT_PRECISION_HIGH\n";
+    m_defines += "precision highp float;\n";
+    m_defines += "precision highp int;\n";
+    m_defines += "#else\n";
+    m_defines += "precision mediump float;\n";
+    m_defines += "precision mediump int;\n";
+    m_defines += "#endif\n\n";
+  }
+  else
+  {
+    m_defines += "precision mediump float;\n";
+    m_defines += "precision mediump int;\n\n";
+  }
   m_defines += "#define FragColor gl_FragColor\n";
   m_defines += "#ifndef texture\n#define texture texture2D\n#endif\n\n";
 #endif
@@ -722,16 +2346,13 @@ void CVisualizationMatrix::GatherDefines()
   m_defines += "const float cDistortThreshold = " + std::to_string(m_distortThreshold) + ";\n";
   m_defines += "const vec3 cColor = vec3(" + std::to_string(m_dotColor.red) + "," + std::to_string(m_dotColor.green) + "," + std::to_string(m_dotColor.blue) + ");\n";
 
+  std::string resolution;
   if (m_state.fbwidth && m_state.fbheight)
-  {
-    m_defines += "const vec2 cResolution = vec2(" + std::to_string(m_state.fbwidth) + "," + std::to_string(m_state.fbheight) + ");\n";
-    m_defines += "const vec2 iResolution = vec2(" + std::to_string(m_state.fbwidth) + "," + std::to_string(m_state.fbheight) + ");\n";//TODO remove from shaders
-  }
+    resolution = "vec2(" + std::to_string(m_state.fbwidth) + "," + std::to_string(m_state.fbheight) + ")";
   else
-  {
-    m_defines += "const vec2 cResolution = vec2(" + std::to_string(Width()) + ".," + std::to_string(Height()) + ".);\n";
-    m_defines += "const vec2 iResolution = vec2(" + std::to_string(Width()) + ".," + std::to_string(Height()) + ".);\n";//TODO remove from shaders
-  }
+    resolution = "vec2(" + std::to_string(Width()) + ".," + std::to_string(Height()) + ".)";
+  m_defines += "const vec2 cResolution = " + resolution + ";\n";
+  m_defines += "const vec2 iResolution = " + resolution + ";\n";//TODO remove from shaders
 
   m_defines += "uniform sampler2D iChannel0;\n";
 
@@ -753,12 +2374,70 @@ void CVisualizationMatrix::GatherDefines()
 
   if (g_presets[m_currentPreset].channel[3] == 2)
   {
-    m_defines += "uniform vec3 iAlbumPosition;\n";
+    m_defines += "uniform mediump vec3 iAlbumPosition;\n";
     m_defines += "uniform vec3 iAlbumRGB;\n";
   }
 
   m_defines += "uniform float iTime;\n";
 
+  // Texture coordinates which only depend on the screen position. On GLES
+  // they come from the vertex shader to avoid dependent texture reads.
+#if defined(HAS_GL)
+  m_defines += "#define FRAG_UV ((gl_FragCoord.xy-0.5*iResolution.xy)/iResolution.y)\n";
+  m_defines += "#define DISTORT_COORD(uv) vec2((uv.y +1.)*.5,1.0)\n";
+  m_defines += "#define LOGO_COORD(uv) (uv+.5)\n";
+  m_defines += "#define ALBUM_COORD(uv) (uv*iAlbumPosition.z + iAlbumPosition.xy)\n";
+  m_defines += "#define FFT_COORD(uv) vec2((1.-abs(uv.x))*.7,0.0)\n";
+  m_defines += "#define WAVEFORM_COORD(uv) vec2(uv.x*.15+.5,0.75)\n";
+  m_defines += "#define ENVELOPE_COORD(uv) vec2(uv.x*.5+.5,0.75)\n";
+  m_defines += "#define NOISE_COORD (gl_FragCoord.xy/(256.*iDotSize))\n";
+#else
+  m_defines += "#define dVaryingCoords\n";
+  m_defines += "varying vec2 vUV;\n";
+  m_defines += "varying vec2 vDistortCoord;\n";
+  m_defines += "varying vec2 vLogoCoord;\n";
+  m_defines += "varying vec2 vAlbumCoord;\n";
+  m_defines += "varying vec2 vFFTCoord;\n";
+  m_defines += "varying vec2 vWaveformCoord;\n";
+  m_defines += "varying vec2 vEnvelopeCoord;\n";
+  m_defines += "varying vec2 vNoiseCoord;\n";
+  m_defines += "#define FRAG_UV vUV\n";
+  m_defines += "#define DISTORT_COORD(uv) vDistortCoord\n";
+  m_defines += "#define LOGO_COORD(uv) vLogoCoord\n";
+  m_defines += "#define ALBUM_COORD(uv) vAlbumCoord\n";
+  m_defines += "#define FFT_COORD(uv) vFFTCoord\n";
+  m_defines += "#define WAVEFORM_COORD(uv) vWaveformCoord\n";
+  m_defines += "#define ENVELOPE_COORD(uv) vEnvelopeCoord\n";
+  m_defines += "#define NOISE_COORD vNoiseCoord\n";
+#endif
+  if (m_checkerboardActive)
+    m_defines += CCheckerboard::Defines();
+  if (m_variableRateActive)
+    m_defines += CVariableRate::Defines();
+
+  if (m_cellPassActive || m_hybridActive)
+  {
+    // Covers every gv = floor(uv*cColumns) on screen, uv.y spans one unit
+    // and uv.x the aspect ratio
+    float width = m_state.fbwidth ? m_state.fbwidth : Width();
+    float height = m_state.fbheight ? m_state.fbheight : Height();
+    float columns = static_cast<float>(Width())/(m_dotSize*2.0f);
+    int halfWidth = static_cast<int>(std::ceil(columns * width / height * 0.5f)) + 1;
+    int halfHeight = static_cast<int>(std::ceil(columns * 0.5f)) + 1;
+    m_cellWidth = halfWidth * 2;
+    m_cellHeight = halfHeight * 2;
+    m_defines += "uniform sampler2D iCells;\n";
+    m_defines += "const vec2 cCellOffset = vec2(" + std::to_string(-halfWidth) + ".," + std::to_string(-halfHeight) + ".);\n";
+    m_defines += "const vec2 cCellSize = vec2(" + std::to_string(m_cellWidth) + ".," + std::to_string(m_cellHeight) + ".);\n";
+    m_defines += "#define CELL_COORD(gv) ((gv-cCellOffset+.5)/cCellSize)\n";
+  }
+
+  if (m_shaderVariant & SHADER_VARIANT_DOT_LUT)
+  {
+    m_defines += "uniform sampler2D iDotLUT;\n";
+    m_defines += "#define dDotLUT\n";
+  }
+
   //TODO: make pretty
   m_defines += "#define RNDSEED1 170.12\n";
   m_defines += "#define RNDSEED2 7572.1\n";
@@ -780,6 +2459,17 @@ void CVisualizationMatrix::GatherDefines()
     m_defines += fsCommonFunctionsNormal;
   }
 
+  m_vertexDefines = "";
+#if defined(HAS_GL)
+  m_vertexDefines += "#version 150\n\n";
+#else
+  m_vertexDefines += "#version 100\n\n";
+  m_vertexDefines += "#define dVaryingCoords\n";
+  m_vertexDefines += "const float iDotSize = " + std::to_string(m_dotSize) + ";\n";
+  m_vertexDefines += "const vec2 iResolution = " + resolution + ";\n";
+  m_vertexDefines += "uniform mediump vec3 iAlbumPosition;\n\n";
+#endif
+
   kodi::Log(ADDON_LOG_DEBUG, "Fragment shader header\n%s",m_defines.c_str());
 }
 
@@ -27,6 +27,32 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "kissfft/kiss_fft.h"
+#include "AlbumCache.h"
+#include "AlbumLoader.h"
+#include "AnalysisGovernor.h"
+#include "AnalysisState.h"
+#include "CellRenderer.h"
+#include "Checkerboard.h"
+#include "DeviceProfile.h"
+#include "DirtyRows.h"
+#include "FFTEngine.h"
+#include "FrameCapture.h"
+#include "FrameReplay.h"
+#include "GLDeletionQueue.h"
+#include "GPUTimer.h"
+#include "Image.h"
+#include "MemoryBudget.h"
+#include "PresetCompiler.h"
+#include "Statistics.h"
+#include "TextureUploader.h"
+#include "ThreadPool.h"
+#include "VariableRate.h"
+
+#include <chrono>
+#include <mutex>
+
+// Number of audio textures written in turns, see RenderTo
+#define AUDIO_TEXTURE_RING (3)
 
 class ATTRIBUTE_HIDDEN CVisualizationMatrix
   : public kodi::addon::CAddonBase
@@ -50,47 +76,103 @@ public:
 
 private:
   void RenderTo(GLuint shader, GLuint effect_fb);
-  void Mix(float* destination, const float* source, size_t frames, size_t channels);
-  void WriteToBuffer(const float* input, size_t length, size_t channels);
+  void Mix(float* destination, const float* source, size_t frames, size_t channels, size_t mixChannels);
+  void WriteToBuffer(const float* input, size_t length, size_t channels, size_t mixChannels);
+  void SetupFFTEngines(bool retune);
   void Launch(int preset);
-  void LoadPreset(const std::string& shaderPath);
+  void WaitForFrameSlot();
+  void LogStatistics();
+  void SetLowpower(bool lowpower);
+  std::string RendererName();
+  void StartBenchmark();
+  void BenchmarkLaunch();
+  void BenchmarkFrame();
+  void FinishBenchmark();
+  void ScenarioLaunch();
+  void ScenarioFrame();
+  void ScenarioAction();
+  void ResumeGLResources();
+  void AbortBenchmark(bool relaunch);
+  bool GLResourcesAlive();
+  void ReleaseGLResources();
+  void ForgetGLResources();
+  void LoadPreset(const std::string& shaderPath, bool cellPass = true);
   void UnloadPreset();
+  bool LoadCellPass(const std::string& vertexShader, const std::string& fragmentShader, const std::string& main);
+  void RenderCells(float time);
+  void SetupCellRenderer(const CPresetCompiler::CellProgram& program);
+  void StartCells(float time);
+  std::vector<unsigned char> RenderStill();
+  static double ImageDifference(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference);
   void UnloadTextures();
+  CImage LoadChannelImage(int channel);
   GLuint CreateTexture(GLint format, unsigned int w, unsigned int h, const GLvoid* data);
   GLuint CreateTexture(const GLvoid* data, GLint format, unsigned int w, unsigned int h, GLint internalFormat, GLint scaling, GLint repeat);
-  GLuint CreateTexture(const std::string& file, GLint internalFormat, GLint scaling, GLint repeat);
+  GLuint CreateTexture(const CImage& image, GLint internalFormat, GLint scaling, GLint repeat);
+  GLuint CreateTexture(const CTextureData::Level& level, GLenum format, GLint scaling, GLint repeat);
   float BlackmanWindow(float in, size_t i, size_t length);
   void SmoothingOverTime(float* outputBuffer, float* lastOutputBuffer, kiss_fft_cpx* inputBuffer, size_t length, float smoothingTimeConstant, unsigned int fftSize);
   float LinearToDecibels(float linear);
   int DetermineBitsPrecision();
   bool UpdateAlbumart();
+  void SetAlbumTexture(GLuint texture, size_t bytes, bool owned = true);
+  void SetAlbumImage(const std::string& file);
+  void UpdateAlbumTexture();
+  void UpdateAlbumMemory();
+  size_t AlbumMaxPixels() const;
+  void CaptureFrame();
+  void StartReplay();
+  void FinishReplay(bool report);
+  CThreadPool& ThreadPool();
   void GatherDefines();
+  int SelectShaderVariant();
+  void AutotuneFrame();
+  GLuint CreateDotLUT();
+  static std::vector<GLubyte> DotLUT();
   //double MeasurePerformance(const std::string& shaderPath, int size);
 
-  kiss_fft_cfg m_kissCfg;
-  GLubyte* m_audioData;
-  float* m_magnitudeBuffer;
-  float* m_pcm;
+  std::vector<std::unique_ptr<IFFTEngine>> m_fftEngines; // one per analysis tier
+  CAnalysisState m_analysis; // written by AudioData(...), read by RenderTo(...)
+  CAnalysisGovernor m_governor;
+  CMemoryBudget m_memory;
+  CDeviceProfile m_profile;
+  std::unique_ptr<CThreadPool> m_threadPool;
+  std::unique_ptr<CCellRenderer> m_cellRenderer; // hybrid mode, uses m_threadPool
+  std::unique_ptr<CAlbumLoader> m_albumLoader; // uses m_threadPool
 
   bool m_initialized = false;
+  bool m_glResources = false; // GPU objects exist, kept across Stop()/Start()
   int64_t m_initialTime = 0; // in ms
   double m_lastAlbumChange = 0;
   bool m_AlbumNeedsUpload = true;
   bool m_lowpower = false;
+  bool m_cellPass = true; // compute cell only stages in a separate pass
+  bool m_cellPassActive = false; // the loaded preset has a cell pass
+  bool m_hybrid = false; // compute the cells on the CPU
+  bool m_hybridActive = false;
+  CheckerboardMode m_checkerboardMode = CHECKERBOARD_OFF;
+  bool m_checkerboardActive = false; // the loaded preset draws half the pixels
+  bool m_variableRateShading = false;
+  bool m_variableRateActive = false; // the loaded preset shades the edges coarse
+  bool m_compressAlbums = true;
+  GLenum m_albumFormat = 0; // compressed format of the context, 0 for none
   float m_albumX = 0.0;
   float m_albumY = 0.0;
   int m_bitsPrecision = 0;
   int m_currentPreset = 0;
+  int m_shaderVariant = 0; // see ShaderVariant
+  bool m_tuning = false; // Autotuning is rendering, keep the textures unchanged
+  float m_frozenTime = -1.0f; // Used instead of the clock if not negative
   float m_dotSize = 0.0;
   float m_fallSpeed = 0.25;
   float m_distortThreshold = 0.0;
   float m_noiseFluctuation = 0.0;
 
   int m_samplesPerSec = 0; // Given by Start(...)
-  bool m_needsUpload = true; // Set by AudioData(...) to mark presence of data
 
   std::string m_albumArt = "";
   std::string m_defines = "";
+  std::string m_vertexDefines = "";
 
   //GLint m_attrResolutionLoc = 0;
   GLint m_attrGlobalTimeLoc = 0;
@@ -103,11 +185,140 @@ private:
   //GLint m_attrChannelResolutionLoc = 0;
   GLint m_attrChannelLoc[4] = {0};
   GLuint m_channelTextures[4] = {0};
+  bool m_albumTextureOwned = true; // false if m_channelTextures[3] is in m_albumCache
+  size_t m_albumTextureBytes = 0; // of an owned m_channelTextures[3]
+  GLuint m_audioTextures[AUDIO_TEXTURE_RING] = {0};
+  int m_audioTextureIndex = 0;
+  CImage m_logoField; // distance field of the logo, see LoadChannelImage()
+  std::string m_logoFieldFile;
+  CDirtyRows m_audioRows; // contents of m_audioTextures
+  std::vector<CDirtyRows::Span> m_audioSpans;
+  GLint m_attrDotLUTLoc = 0;
+  GLuint m_dotLUTTexture = 0;
   //GLint m_attrDotSizeLoc = 0;
+  GLint m_attrCellsLoc = 0;
+  GLint m_attrParityLoc = 0;
+  GLint m_attrPixelScaleLoc = 0;
+  GLint m_cellTimeLoc = 0;
+  GLint m_cellNoiseLoc = 0;
+  GLint m_cellVertexLoc = 0;
+  GLuint m_cellTexture = 0;
+  GLuint m_cellFB = 0;
+  int m_cellWidth = 0;
+  int m_cellHeight = 0;
+  GLuint m_hybridTextures[AUDIO_TEXTURE_RING] = {0}; // written in turns like the audio
+  int m_hybridTextureIndex = 0;
+  float m_lastCellTime = 0.0f;
+  float m_albumRGB[3] = {0.0f, 0.0f, 0.0f};
+
+  std::unique_ptr<kodi::gui::gl::CShaderProgram> m_matrixShader;
+  std::unique_ptr<kodi::gui::gl::CShaderProgram> m_cellShader;
+  CGLDeletionQueue m_deletionQueue;
+  CTextureUploader m_albumUploader; // uses m_deletionQueue
+  CAlbumCache m_albumCache; // uses m_deletionQueue
+  CCheckerboard m_checkerboard; // uses m_deletionQueue
+  CVariableRate m_variableRate; // uses m_deletionQueue
+  std::string m_albumFile; // cover on screen or being uploaded
+
+  int m_framesInFlight = 0; // frames the driver may queue, 0 for no limit
+#if defined(HAS_GL_SYNC)
+  std::deque<GLsync> m_frameFences;
+#endif
+
+  // Telemetry written from the audio and the render thread, see LogStatistics()
+  std::mutex m_statsMutex;
+  CHistogram m_audioInterval;
+  CHistogram m_audioLength;
+  CHistogram m_analysisTime;
+  CHistogram m_frameInterval;
+  CHistogram m_fenceWait;
+  CValueCounts m_startChannels;
+  CValueCounts m_startSampleRates;
+  unsigned int m_sampleRateChanges = 0;
+  unsigned int m_albumsCompressed = 0;
+  unsigned int m_albumsFromDisk = 0;
+  double m_albumCompressMs = 0.0;
+  double m_albumDiskMs = 0.0;
+  std::chrono::high_resolution_clock::time_point m_lastAudioData;
+  std::chrono::high_resolution_clock::time_point m_lastFrame;
+  std::chrono::high_resolution_clock::time_point m_lastStatistics;
+
+  struct BenchmarkResult
+  {
+    int preset;
+    int tier;
+    int frames;
+    double cpuTime; // ms per frame to submit
+    double gpuTime; // ms per frame on the GPU
+    double gpuTime95;
+    double gpuTimeMax;
+    double difference; // still image against the normal tier, negative if not compared
+    float shaded; // shading cost against shading every pixel
+  };
 
-  kodi::gui::gl::CShaderProgram m_matrixShader;
+  struct ScenarioResult
+  {
+    int scenario;
+    int actions;
+    int frames;
+    double worstFrame; // ms between two frames
+    int stalls;
+    long long memoryGrowth; // accounted by m_memory, bytes
+    long long residentGrowth; // whole process, bytes
+  };
+
+  // Self-benchmark, runs one offscreen frame per Render() call. Afterwards
+  // the scenarios measure the visible frames during transitions.
+  struct
+  {
+    bool active = false;
+    int preset = 0;
+    int tier = 0;
+    int scenario = -1; // running scenario, -1 while the presets are measured
+    int actions = 0;
+    std::vector<double> intervals;
+    std::chrono::high_resolution_clock::time_point lastFrame;
+    std::chrono::high_resolution_clock::time_point lastAction;
+    size_t memory = 0;
+    size_t resident = 0;
+    std::vector<ScenarioResult> scenarioResults;
+    int frames = 0;
+    double cpuTime = 0.0;
+    std::vector<double> gpuTimes;
+    std::chrono::high_resolution_clock::time_point start;
+    int savedPreset = 0;
+    bool savedLowpower = false;
+    bool savedCellPass = true;
+    bool savedHybrid = false;
+    CheckerboardMode savedCheckerboard = CHECKERBOARD_OFF;
+    bool savedVariableRate = false;
+    std::vector<unsigned char> reference; // still image of the normal tier
+    double difference = -1.0;
+    std::vector<BenchmarkResult> results;
+  } m_benchmark;
+  // Shader variant autotuning, one step per Render() call, see
+  // AutotuneFrame()
+  struct
+  {
+    bool active = false;
+    std::string key; // device profile entry of the result
+    std::vector<int> variants;
+    size_t next = 0; // variant being measured
+    int frames = -1; // timed frames of it, -1 until it is loaded and checked
+    std::vector<double> times; // of the timed frames, in ms
+    int best = 0;
+    double bestTime = 0.0;
+    std::vector<unsigned char> reference; // still image of the default variant
+  } m_autotune;
   //kodi::gui::gl::CShaderProgram m_displayShader;
 
+  // Sources of the loaded programs for a frame capture, see CaptureFrame()
+  CFrameCapture::Program m_matrixSources;
+  CFrameCapture::Program m_cellSources;
+  bool m_capturePending = false;
+  std::vector<uint8_t> m_capturedCells; // hybrid cells of the captured frame
+  std::unique_ptr<CFrameReplay> m_replay;
+
   struct
   {
     float red;
@@ -124,7 +335,7 @@ private:
     GLuint framebuffer_texture;
     GLuint uScale;
     int fbwidth, fbheight;
-  } m_state;
+  } m_state = {};
 
   std::string m_usedShaderFile;
   struct ShaderPath
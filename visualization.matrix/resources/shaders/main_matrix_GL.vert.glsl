@@ -1,5 +1,3 @@
-#version 150
-
 in vec4 vertex;
 
 void main(void)
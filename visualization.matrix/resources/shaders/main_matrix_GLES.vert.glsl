@@ -1,8 +1,32 @@
-#version 100
-
 attribute vec4 vertex;
 
+#ifdef dVaryingCoords
+varying vec2 vUV;
+varying vec2 vDistortCoord;
+varying vec2 vLogoCoord;
+varying vec2 vAlbumCoord;
+varying vec2 vFFTCoord;
+varying vec2 vWaveformCoord;
+varying vec2 vEnvelopeCoord;
+varying vec2 vNoiseCoord;
+#endif
+
 void main(void)
 {
   gl_Position = vertex;
+
+#ifdef dVaryingCoords
+  // Texture coordinates which are linear over the screen are interpolated
+  // here, so the fragment shader fetches them without a dependent read.
+  // The geometry is split at x = 0 to keep abs(uv.x) linear per triangle.
+  vec2 uv = vertex.xy*vec2(iResolution.x/iResolution.y,1.)*.5;
+  vUV = uv;
+  vDistortCoord = vec2((uv.y +1.)*.5,1.0);
+  vLogoCoord = uv+.5;
+  vAlbumCoord = uv*iAlbumPosition.z + iAlbumPosition.xy;
+  vFFTCoord = vec2((1.-abs(uv.x))*.7,0.0);
+  vWaveformCoord = vec2(uv.x*.15+.5,0.75);
+  vEnvelopeCoord = vec2(uv.x*.5+.5,0.75);
+  vNoiseCoord = (vertex.xy*.5+.5)*iResolution/(256.*iDotSize);
+#endif
 }
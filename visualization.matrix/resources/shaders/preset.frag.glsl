@@ -0,0 +1 @@
+// main() is generated from the stages of the preset, see CPresetCompiler